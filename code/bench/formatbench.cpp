@@ -0,0 +1,108 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Benchmark of reading certificates in the text and the binary format, possibly compressed
+//
+// Every file is read completely through CertificateInput, converting all numbers to mpq_class,
+// and size on disk and parse time are reported.  To compare the formats, pass
+// the same certificate converted by viprconv, e.g., cert.vipr cert.vipr.gz cert.viprb.
+//
+// Usage: formatbench certificate...
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <sys/stat.h>
+#include "viprio.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+   if( argc < 2 )
+   {
+      cerr << "Usage: " << argv[0] << " certificate..." << endl;
+      return 1;
+   }
+
+   cout << left << setw(40) << "file" << right << setw(8) << "format" << setw(12) << "disk MB"
+        << setw(12) << "seconds" << setw(12) << "numbers" << setw(12) << "strings" << endl;
+
+   for( int i = 1; i < argc; ++i )
+   {
+      CertificateInput in;
+      struct stat st;
+
+      if( stat(argv[i], &st) != 0 || !in.open(argv[i]) )
+      {
+         cerr << "Failed to open file " << argv[i] << endl;
+         return 1;
+      }
+
+      long numbers = 0;
+      long strings = 0;
+      mpq_class value;
+      Token token;
+      RationalLiteral lit;
+      string scratch;
+      auto start = chrono::steady_clock::now();
+
+      if( in.isBinary() )
+      {
+         for( ;; )
+         {
+            if( in.nextIsNumber() )
+            {
+               in >> value;
+               ++numbers;
+            }
+            else if( in.next(token) )
+               ++strings;
+            else
+               break;
+         }
+      }
+      else
+      {
+         while( in.next(token) )
+         {
+            if( splitRational(token.data, token.size, lit) )
+            {
+               parseRational(token.data, token.size, value.get_mpq_t(), scratch);
+               ++numbers;
+            }
+            else
+               ++strings;
+         }
+      }
+
+      chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+      cout << left << setw(40) << argv[i] << right << setw(8) << (in.isBinary() ? "binary" : "text")
+           << setw(12) << st.st_size / 1e6 << setw(12) << duration.count() << setw(12) << numbers
+           << setw(12) << strings << endl;
+   }
+
+   return 0;
+}
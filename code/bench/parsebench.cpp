@@ -0,0 +1,120 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Micro benchmark of the rational literal parser of viprio.h against reading the same
+// literals through std::istream >> mpq_class, the path viprchk used before
+//
+// Usage: parsebench [number of literals]
+
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include "viprio.h"
+
+using namespace std;
+
+// A mix resembling certificate coefficients: mostly small integers, short fractions and some
+// long fractions that need GMP
+static string generateLiterals(long count)
+{
+   mt19937_64 rng(4711);
+   ostringstream out;
+
+   for( long i = 0; i < count; ++i )
+   {
+      int kind = rng() % 10;
+      long long a = (long long)(rng() % 2000) - 1000;
+
+      if( kind < 6 )
+         out << a;
+      else if( kind < 9 )
+         out << a << "/" << (rng() % 64 + 1);
+      else
+      {
+         mpz_class num(to_string(rng()) + to_string(rng()));
+         mpz_class den(to_string(rng() % 1000000 + 1) + to_string(rng()));
+         out << (a < 0 ? "-" : "") << num << "/" << den;
+      }
+      out << ((i % 16 == 15) ? '\n' : ' ');
+   }
+
+   return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+   long count = argc > 1 ? atol(argv[1]) : 5000000;
+   string text = generateLiterals(count);
+   vector<mpq_class> viaStream(count);
+   vector<mpq_class> viaParser(count);
+
+   cout << "Parsing " << count << " literals (" << text.size() / 1e6 << " MB)" << endl;
+
+   auto start = chrono::steady_clock::now();
+   {
+      istringstream in(text);
+      for( long i = 0; i < count; ++i )
+         in >> viaStream[i];
+   }
+   chrono::duration<double> streamTime = chrono::steady_clock::now() - start;
+
+   start = chrono::steady_clock::now();
+   {
+      const char* p = text.data();
+      const char* end = p + text.size();
+      string scratch;
+
+      for( long i = 0; i < count; ++i )
+      {
+         while( (unsigned char)*p <= ' ' )
+            ++p;
+         const char* q = p;
+         while( q < end && (unsigned char)*q > ' ' )
+            ++q;
+         parseRational(p, q - p, viaParser[i].get_mpq_t(), scratch);
+         p = q;
+      }
+   }
+   chrono::duration<double> parserTime = chrono::steady_clock::now() - start;
+
+   // the stream does not canonicalize, which parseRational does
+   for( long i = 0; i < count; ++i )
+   {
+      viaStream[i].canonicalize();
+      if( viaStream[i] != viaParser[i] )
+      {
+         cerr << "Mismatch for literal " << i << ": " << viaStream[i] << " != " << viaParser[i] << endl;
+         return 1;
+      }
+   }
+
+   cout << "istream >> mpq_class: " << streamTime.count() << " s, "
+        << text.size() / 1e6 / streamTime.count() << " MB/s" << endl;
+   cout << "parseRational:        " << parserTime.count() << " s, "
+        << text.size() / 1e6 / parserTime.count() << " MB/s" << endl;
+   cout << "Speedup: " << streamTime.count() / parserTime.count() << endl;
+
+   return 0;
+}
@@ -26,13 +26,15 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include "viprstream.h"
+#include "viprindex.h"
 
 #define VERSION_MAJOR 1
 #define VERSION_MINOR 1
 
 using namespace std;
 
-ifstream pf;
+InputFile pf;
 ofstream html;
 vector<string> colName;
 vector<string> rowName;
@@ -43,22 +45,67 @@ vector<bool> isInt; // boolean indicators for integer variable indices
 int main(int argc, char *argv[])
 {
    int rs = -1;
+   int farg = 0;
+   int first = 0;
+   int last = -1;              // last derivation to show, -1 for all
+   bool buildIndex = false;
+   CertificateIndex index;
 
-   if( argc != 2 )
+   for( int i = 1; i < argc; ++i )
    {
-      cerr << "Usage: " << argv[0] << " filename\n";
+      string arg = argv[i];
+
+      if( arg.compare(0, 14, "--derivations=") == 0 && arg.find(':') != string::npos )
+      {
+         first = atoi( arg.substr(14).c_str() );
+         last = atoi( arg.substr(arg.find(':') + 1).c_str() );
+         if( first < 0 || last < first )
+         {
+            farg = 0;
+            break;
+         }
+      }
+      else if( arg == "--index" )
+         buildIndex = true;
+      else if( farg == 0 && arg.compare(0, 2, "--") != 0 )
+         farg = i;
+      else
+      {
+         farg = 0;
+         break;
+      }
+   }
+
+   if( farg == 0 )
+   {
+      cerr << "Usage: " << argv[0] << " [--derivations=<first>:<last>] [--index] filename\n" << endl;
+      cerr << "Shows only the given derivations, counted from 0, if --derivations is given.  They" << endl;
+      cerr << "are located through the index filename.idx, which --index creates if necessary." << endl;
       return rs;
    }
 
-   pf.open( argv[1] );
+   pf.open( argv[farg] );
 
    if( pf.fail() )
    {
-      cerr << "Failed to open file " << argv[1] << endl;
+      cerr << "Failed to open file " << argv[farg] << endl;
       return rs;
    }
 
-   string htmlFname = string(argv[1]) + ".html";
+   if( (last >= 0 || buildIndex) && !index.load( argv[farg] ) )
+   {
+      if( !index.build( argv[farg] ) )
+      {
+         cerr << "Failed to index file " << argv[farg] << endl;
+         return rs;
+      }
+      if( buildIndex && !index.save( argv[farg] ) )
+         cerr << "Failed to write index " << CertificateIndex::fileName( argv[farg] ) << endl;
+   }
+
+   string htmlFname = argv[farg];
+   stripCompressionExtension(htmlFname);
+   htmlFname += ".html";
 
    html.open( htmlFname.c_str());
 
@@ -396,12 +443,49 @@ int main(int argc, char *argv[])
       html << "<P><B>Derivations:</B></P>" << endl;
       html << "<TABLE cellpadding='8'>" << endl;
 
-      for( int i = 0; i < numDer; ++i )
+      rowName.resize( numCon + numDer );
+
+      // Only the labels of the derivations before the range that are referenced in it are read
+      if( last >= 0 )
+      {
+         if( numDer != index.numberOfDerivations() || numCon != index.numberOfConstraints() )
+         {
+            cerr << "Index does not match the certificate" << endl;
+            stat = false;
+            goto TERMINATE;
+         }
+
+         last = min( last, numDer - 1 );
+
+         for( int i = first; i <= last; ++i )
+         {
+            size_t count;
+            const int* refs = index.references( i, count );
+
+            for( size_t j = 0; j < count; ++j )
+            {
+               if( refs[j] >= numCon && refs[j] < numCon + first && rowName[ refs[j] ].empty() )
+               {
+                  pf.seekg( index.offset( refs[j] - numCon ) );
+                  pf >> rowName[ refs[j] ];
+               }
+            }
+         }
+
+         pf.seekg( index.offset( first ) );
+      }
+      else
+      {
+         first = 0;
+         last = numDer - 1;
+      }
+
+      for( int i = first; i <= last; ++i )
       {
          html << "<TR>" << endl;
          pf >> label >> sense >> tmp;
 
-         rowName.push_back( label );
+         rowName[ numCon + i ] = label;
 
          html << "<TD> " << numCon + i << " </TD>" << endl;
          html << "<TD> " << label << " </TD>" << endl;
@@ -0,0 +1,317 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Dense accumulator for linear combinations of sparse rows
+//
+// DenseAccumulator holds one value per variable together with the list of indices that have
+// been touched since the last clear().  Adding a multiple of a sparse row therefore costs one
+// array access per nonzero, and clearing only resets the touched entries, so that one
+// accumulator sized to the number of variables can be reused for all derivations.  The value
+// type is a template parameter such that it serves both mpq_class (viprchk) and SoPlex's
+// Rational (viprcomp).
+//
+// CommonDenominatorAccumulator computes the same sums, but keeps integer numerators over one
+// shared denominator.  Adding a product then is a single mpz_addmul, while adding rationals
+// needs a gcd for every addition.  The denominator only grows when a product has a denominator
+// that does not divide it yet, in which case all touched numerators are scaled up; the sums
+// are canonicalized once when they are read.  Comparing an entry with a given rational is a
+// cross multiplication and needs no canonicalization at all.
+
+#ifndef VIPRACCUM_H
+#define VIPRACCUM_H
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <gmpxx.h>
+
+
+template <class T>
+class DenseAccumulator
+{
+   public:
+      DenseAccumulator(size_t dimension = 0) { resize(dimension); }
+
+      // number of variables; may only be changed while no entry is touched
+      size_t dimension() const { return _values.size(); }
+      void resize(size_t dimension) { assert(_touched.empty());
+                                      _values.resize(dimension); _isTouched.resize(dimension, 0); }
+
+      // current value, zero for untouched entries
+      const T& operator[](int index) const { return _values[index]; }
+
+      // writable reference to an entry, which is marked as touched
+      T& ref(int index) { _touch(index); return _values[index]; }
+
+      // adds a * b to an entry
+      void addProduct(int index, const T& a, const T& b) { _touch(index); _values[index] += a * b; }
+
+      // touched indices in order of first touch, or increasing after sortTouched()
+      size_t numberOfTouched() const { return _touched.size(); }
+      int touched(size_t k) const { return _touched[k]; }
+      void sortTouched() { std::sort(_touched.begin(), _touched.end()); }
+
+      // resets all touched entries to zero in O(touched)
+      void clear()
+      {
+         for( auto it = _touched.begin(); it != _touched.end(); ++it )
+         {
+            _values[*it] = 0;
+            _isTouched[*it] = 0;
+         }
+         _touched.clear();
+      }
+
+   private:
+      void _touch(int index)
+      {
+         assert(index >= 0 && size_t(index) < _values.size());
+
+         if( !_isTouched[index] )
+         {
+            _isTouched[index] = 1;
+            _touched.push_back(index);
+         }
+      }
+
+      std::vector<T> _values;
+      std::vector<char> _isTouched;
+      std::vector<int> _touched;
+};
+
+
+
+// Sum of multiplier * value products with integer numerators over a common denominator.  Index
+// -1 denotes an additional entry, e.g., for the right-hand side, that is not listed as touched
+class CommonDenominatorAccumulator
+{
+   public:
+      CommonDenominatorAccumulator(size_t dimension = 0) { resize(dimension); }
+
+      size_t dimension() const { return _numerators.size(); }
+      void resize(size_t dimension) { assert(_touched.empty());
+                                      _numerators.resize(dimension); _isTouched.resize(dimension, 0); }
+
+      // multiplier of the following products, num/den with den > 0
+      void setMultiplier(mpz_srcptr num, mpz_srcptr den);
+      void setMultiplier(long num, unsigned long den);
+
+      // adds multiplier * value to an entry
+      void addInteger(int index, long value);
+      void addInteger(int index, mpz_srcptr value);
+      void addFraction(int index, mpz_srcptr num, mpz_srcptr den);
+      void addFraction(int index, long num, unsigned long den);
+
+      // canonical value of an entry
+      void get(int index, mpq_t value) const;
+      bool isZero(int index) const { return mpz_sgn(_entry(index).get_mpz_t()) == 0; }
+
+      // comparisons of an entry without canonicalizing it, num/den with den > 0
+      bool isInteger(int index) const { return mpz_divisible_p(_entry(index).get_mpz_t(),
+                                                               _denominator.get_mpz_t()) != 0; }
+      bool equals(int index, mpz_srcptr num, mpz_srcptr den);
+      bool equals(int index, long num, unsigned long den);
+
+      size_t numberOfTouched() const { return _touched.size(); }
+      int touched(size_t k) const { return _touched[k]; }
+      void sortTouched() { std::sort(_touched.begin(), _touched.end()); }
+
+      // resets all touched entries, the additional entry and the denominator
+      void clear();
+
+   private:
+      mpz_class& _entry(int index) { if( index >= 0 ) _touch(index); return index >= 0 ? _numerators[index] : _extra; }
+      const mpz_class& _entry(int index) const { return index >= 0 ? _numerators[index] : _extra; }
+      void _touch(int index)
+      {
+         assert(index >= 0 && size_t(index) < _numerators.size());
+
+         if( !_isTouched[index] )
+         {
+            _isTouched[index] = 1;
+            _touched.push_back(index);
+         }
+      }
+      void _extend(const mpz_class &den); // makes den divide the common denominator
+
+      std::vector<mpz_class> _numerators;
+      std::vector<char> _isTouched;
+      std::vector<int> _touched;
+      mpz_class _extra;
+      mpz_class _denominator = 1;
+      mpz_class _multiplierNum;
+      mpz_class _multiplierDen = 1;
+      mpz_class _scaled;                  // multiplier * common denominator, an integer
+      mpz_class _num;                     // scratch
+      mpz_class _den;
+      mpz_class _factor;
+};
+
+
+inline void CommonDenominatorAccumulator::_extend(const mpz_class &den)
+{
+   if( mpz_divisible_p(_denominator.get_mpz_t(), den.get_mpz_t()) )
+      return;
+
+   mpz_gcd(_factor.get_mpz_t(), _denominator.get_mpz_t(), den.get_mpz_t());
+   mpz_divexact(_factor.get_mpz_t(), den.get_mpz_t(), _factor.get_mpz_t());
+
+   _denominator *= _factor;
+   _scaled *= _factor;
+   _extra *= _factor;
+   for( auto it = _touched.begin(); it != _touched.end(); ++it )
+      _numerators[*it] *= _factor;
+}
+
+
+inline void CommonDenominatorAccumulator::setMultiplier(mpz_srcptr num, mpz_srcptr den)
+{
+   mpz_set(_multiplierNum.get_mpz_t(), num);
+   mpz_set(_multiplierDen.get_mpz_t(), den);
+
+   _extend(_multiplierDen);
+   mpz_divexact(_scaled.get_mpz_t(), _denominator.get_mpz_t(), _multiplierDen.get_mpz_t());
+   _scaled *= _multiplierNum;
+}
+
+
+inline void CommonDenominatorAccumulator::setMultiplier(long num, unsigned long den)
+{
+   mpz_set_si(_num.get_mpz_t(), num);
+   mpz_set_ui(_den.get_mpz_t(), den);
+   setMultiplier(_num.get_mpz_t(), _den.get_mpz_t());
+}
+
+
+inline void CommonDenominatorAccumulator::addInteger(int index, long value)
+{
+   mpz_class &entry = _entry(index);
+
+   if( value >= 0 )
+      mpz_addmul_ui(entry.get_mpz_t(), _scaled.get_mpz_t(), (unsigned long)value);
+   else
+      mpz_submul_ui(entry.get_mpz_t(), _scaled.get_mpz_t(), -(unsigned long)value);
+}
+
+
+inline void CommonDenominatorAccumulator::addInteger(int index, mpz_srcptr value)
+{
+   mpz_addmul(_entry(index).get_mpz_t(), _scaled.get_mpz_t(), value);
+}
+
+
+// multiplier * num/den = (multiplierNum * num) / (multiplierDen * den)
+inline void CommonDenominatorAccumulator::addFraction(int index, mpz_srcptr num, mpz_srcptr den)
+{
+   if( mpz_cmp_ui(den, 1) == 0 )
+   {
+      addInteger(index, num);
+      return;
+   }
+
+   mpz_mul(_den.get_mpz_t(), _multiplierDen.get_mpz_t(), den);
+   _extend(_den);
+   mpz_divexact(_num.get_mpz_t(), _denominator.get_mpz_t(), _den.get_mpz_t());
+   _num *= _multiplierNum;
+   mpz_addmul(_entry(index).get_mpz_t(), _num.get_mpz_t(), num);
+}
+
+
+inline void CommonDenominatorAccumulator::addFraction(int index, long num, unsigned long den)
+{
+   if( den == 1 )
+   {
+      addInteger(index, num);
+      return;
+   }
+
+   mpz_mul_ui(_den.get_mpz_t(), _multiplierDen.get_mpz_t(), den);
+   _extend(_den);
+   mpz_divexact(_num.get_mpz_t(), _denominator.get_mpz_t(), _den.get_mpz_t());
+   _num *= _multiplierNum;
+
+   mpz_class &entry = _entry(index);
+
+   if( num >= 0 )
+      mpz_addmul_ui(entry.get_mpz_t(), _num.get_mpz_t(), (unsigned long)num);
+   else
+      mpz_submul_ui(entry.get_mpz_t(), _num.get_mpz_t(), -(unsigned long)num);
+}
+
+
+// entry / denominator == num / den iff entry * den == num * denominator
+inline bool CommonDenominatorAccumulator::equals(int index, mpz_srcptr num, mpz_srcptr den)
+{
+   const mpz_class &entry = (index >= 0 ? _numerators[index] : _extra);
+
+   if( mpz_sgn(entry.get_mpz_t()) != mpz_sgn(num) )
+      return false;
+   if( mpz_cmp_ui(_denominator.get_mpz_t(), 1) == 0 && mpz_cmp_ui(den, 1) == 0 )
+      return mpz_cmp(entry.get_mpz_t(), num) == 0;
+
+   mpz_mul(_num.get_mpz_t(), entry.get_mpz_t(), den);
+   mpz_mul(_den.get_mpz_t(), _denominator.get_mpz_t(), num);
+   return mpz_cmp(_num.get_mpz_t(), _den.get_mpz_t()) == 0;
+}
+
+
+inline bool CommonDenominatorAccumulator::equals(int index, long num, unsigned long den)
+{
+   const mpz_class &entry = (index >= 0 ? _numerators[index] : _extra);
+
+   if( mpz_sgn(entry.get_mpz_t()) != (num > 0) - (num < 0) )
+      return false;
+   if( mpz_cmp_ui(_denominator.get_mpz_t(), 1) == 0 && den == 1 )
+      return mpz_cmp_si(entry.get_mpz_t(), num) == 0;
+
+   mpz_mul_ui(_num.get_mpz_t(), entry.get_mpz_t(), den);
+   mpz_mul_si(_den.get_mpz_t(), _denominator.get_mpz_t(), num);
+   return mpz_cmp(_num.get_mpz_t(), _den.get_mpz_t()) == 0;
+}
+
+
+inline void CommonDenominatorAccumulator::get(int index, mpq_t value) const
+{
+   mpz_set(mpq_numref(value), _entry(index).get_mpz_t());
+   mpz_set(mpq_denref(value), _denominator.get_mpz_t());
+   mpq_canonicalize(value);
+}
+
+
+inline void CommonDenominatorAccumulator::clear()
+{
+   for( auto it = _touched.begin(); it != _touched.end(); ++it )
+   {
+      _numerators[*it] = 0;
+      _isTouched[*it] = 0;
+   }
+   _touched.clear();
+   _extra = 0;
+   _denominator = 1;
+   _multiplierNum = 0;
+   _multiplierDen = 1;
+   _scaled = 0;
+}
+
+#endif
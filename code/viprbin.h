@@ -0,0 +1,375 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Binary encoding of .vipr certificates
+//
+// A binary certificate holds the same tokens as the text file, but numbers are stored by value
+// so that reading them needs no decimal conversion.  The file starts with the 8 bytes
+// "VIPRBIN\n" and the format version as varint, followed by a sequence of items.  Every item
+// starts with a header whose lowest 3 bits give the item type; the next 4 bits are the lowest
+// bits of an unsigned payload and bit 7 says whether the remaining payload bits follow as
+// LEB128 varint.
+//
+//   INTEGER    payload is the zigzag encoded 64-bit value
+//   FRACTION   payload is the zigzag encoded numerator, followed by the denominator as varint
+//   BIGNUMBER  payload is 2 * number of numerator limbs + sign, followed by the number of
+//              denominator limbs as varint (0 for integers) and the limbs of numerator and
+//              denominator as 64-bit little endian words, least significant first
+//   STRING     payload is the length, followed by the bytes
+//   LINEBREAK  line break of the text file, payload 0
+//   END        payload is the number of sections, followed by the section table
+//
+// Only integers and fractions in canonical form are stored as numbers; every other token,
+// e.g., the decimal version "1.1", is stored as string, so converting back to text reproduces
+// all tokens exactly.  Comments are stored as one string per line.  The section table lists
+// name and offset of each section keyword, and the last 8 bytes of the file hold the offset of
+// the END item in little endian, such that readers can find the table from the end.
+
+#ifndef VIPRBIN_H
+#define VIPRBIN_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <ostream>
+#include <gmpxx.h>
+
+
+static const char BINARY_MAGIC[] = "VIPRBIN\n";
+static const size_t BINARY_MAGIC_SIZE = 8;
+static const uint64_t BINARY_FORMAT_VERSION = 1;
+
+enum class BinaryItem
+{
+   INTEGER = 0,
+   FRACTION = 1,
+   BIGNUMBER = 2,
+   STRING = 3,
+   LINEBREAK = 4,
+   END = 5
+};
+
+
+inline uint64_t zigzagEncode(int64_t value)
+{
+   return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value)
+{
+   return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+
+// Decodes a LEB128 varint; returns the position after it or nullptr if it is truncated
+inline const char* decodeVarint(const char* p, const char* end, uint64_t &value)
+{
+   value = 0;
+
+   for( int shift = 0; p < end && shift < 64; shift += 7 )
+   {
+      unsigned char byte = (unsigned char)*p++;
+
+      value |= uint64_t(byte & 0x7f) << shift;
+      if( !(byte & 0x80) )
+         return p;
+   }
+
+   return nullptr;
+}
+
+
+// Decodes an item header; returns the position after it or nullptr if it is truncated
+inline const char* decodeItemHeader(const char* p, const char* end, BinaryItem &type, uint64_t &payload)
+{
+   if( p == end )
+      return nullptr;
+
+   unsigned char byte = (unsigned char)*p++;
+
+   type = BinaryItem(byte & 0x7);
+   payload = (byte >> 3) & 0xf;
+
+   if( byte & 0x80 )
+   {
+      uint64_t high;
+
+      p = decodeVarint(p, end, high);
+      payload |= high << 4;
+   }
+
+   return p;
+}
+
+
+// Writes tokens in the binary format to a stream
+class BinaryWriter
+{
+   public:
+      BinaryWriter(std::ostream &out) : _out(out) {}
+
+      void writeHeader();
+      void writeLineBreak();
+      void writeInteger(int64_t value);
+      void writeRational(const mpq_class &value);   // value must be canonical
+      void writeString(const char* str, size_t size);
+      void writeToken(const char* str, size_t size); // chooses the item type of a text token
+      bool finish();                                 // writes the section table
+
+      uint64_t bytesWritten() const { return _offset + _buffer.size(); }
+      const std::vector<std::pair<std::string, uint64_t> >& sections() const { return _sections; }
+
+   private:
+      static const size_t _flushSize = 1 << 20;
+
+      void _header(BinaryItem type, uint64_t payload);
+      void _varint(uint64_t value);
+      void _limbs(mpz_srcptr z);
+      void _flush();
+
+      std::ostream &_out;
+      std::string _buffer;
+      uint64_t _offset = 0;            // bytes flushed to _out
+      bool _lineStart = true;
+      std::vector<std::pair<std::string, uint64_t> > _sections;
+      mpq_class _scratch;
+};
+
+
+inline void BinaryWriter::_varint(uint64_t value)
+{
+   while( value >= 0x80 )
+   {
+      _buffer.push_back(char(0x80 | (value & 0x7f)));
+      value >>= 7;
+   }
+   _buffer.push_back(char(value));
+}
+
+
+inline void BinaryWriter::_header(BinaryItem type, uint64_t payload)
+{
+   unsigned char byte = (unsigned char)(int(type) | ((payload & 0xf) << 3));
+
+   if( payload >> 4 )
+   {
+      _buffer.push_back(char(byte | 0x80));
+      _varint(payload >> 4);
+   }
+   else
+      _buffer.push_back(char(byte));
+}
+
+
+inline void BinaryWriter::_limbs(mpz_srcptr z)
+{
+   size_t count = (mpz_sizeinbase(z, 2) + 63) / 64;
+   size_t start = _buffer.size();
+
+   _buffer.resize(start + 8 * count);
+   mpz_export(&_buffer[start], nullptr, -1, 8, -1, 0, z);
+}
+
+
+inline void BinaryWriter::_flush()
+{
+   _out.write(_buffer.data(), _buffer.size());
+   _offset += _buffer.size();
+   _buffer.clear();
+}
+
+
+inline void BinaryWriter::writeHeader()
+{
+   _buffer.append(BINARY_MAGIC, BINARY_MAGIC_SIZE);
+   _varint(BINARY_FORMAT_VERSION);
+}
+
+
+inline void BinaryWriter::writeLineBreak()
+{
+   _header(BinaryItem::LINEBREAK, 0);
+   _lineStart = true;
+
+   if( _buffer.size() >= _flushSize )
+      _flush();
+}
+
+
+inline void BinaryWriter::writeInteger(int64_t value)
+{
+   _header(BinaryItem::INTEGER, zigzagEncode(value));
+   _lineStart = false;
+}
+
+
+inline void BinaryWriter::writeRational(const mpq_class &value)
+{
+   mpz_srcptr num = value.get_num_mpz_t();
+   mpz_srcptr den = value.get_den_mpz_t();
+   bool isInteger = (mpz_cmp_ui(den, 1) == 0);
+
+   if( mpz_fits_slong_p(num) && sizeof(long) >= sizeof(int64_t) && (isInteger || mpz_fits_slong_p(den)) )
+   {
+      if( isInteger )
+         writeInteger(mpz_get_si(num));
+      else
+      {
+         _header(BinaryItem::FRACTION, zigzagEncode(mpz_get_si(num)));
+         _varint(uint64_t(mpz_get_si(den)));
+      }
+   }
+   else
+   {
+      size_t numLimbs = (mpz_sizeinbase(num, 2) + 63) / 64;
+
+      _header(BinaryItem::BIGNUMBER, 2 * numLimbs + (mpz_sgn(num) < 0 ? 1 : 0));
+      _varint(isInteger ? 0 : (mpz_sizeinbase(den, 2) + 63) / 64);
+      _limbs(num);
+      if( !isInteger )
+         _limbs(den);
+   }
+
+   _lineStart = false;
+}
+
+
+inline void BinaryWriter::writeString(const char* str, size_t size)
+{
+   static const char* const keywords[] = { "VER", "VAR", "INT", "OBJ", "CON", "RTP", "SOL", "DER" };
+
+   // first occurrence of each section keyword at the start of a line
+   if( _lineStart && size == 3 )
+   {
+      std::string name(str, size);
+      bool isKeyword = false;
+      bool seen = false;
+
+      for( const char* keyword : keywords )
+         isKeyword = isKeyword || name == keyword;
+      for( auto &section : _sections )
+         seen = seen || section.first == name;
+
+      if( isKeyword && !seen )
+         _sections.push_back(std::make_pair(name, bytesWritten()));
+   }
+
+   _header(BinaryItem::STRING, size);
+   _buffer.append(str, size);
+   _lineStart = false;
+
+   if( _buffer.size() >= _flushSize )
+      _flush();
+}
+
+
+// Stores canonical integers and fractions by value and everything else as string
+inline void BinaryWriter::writeToken(const char* str, size_t size)
+{
+   auto canonicalInteger = [](const char* p, size_t n, bool allowSign) {
+      if( allowSign && n > 1 && *p == '-' && p[1] != '0' )
+      {
+         ++p;
+         --n;
+      }
+      if( n == 0 || (*p == '0' && n > 1) )
+         return false;
+      for( size_t i = 0; i < n; ++i )
+      {
+         if( (unsigned)(p[i] - '0') > 9 )
+            return false;
+      }
+      return true;
+   };
+
+   const char* slash = static_cast<const char*>(memchr(str, '/', size));
+   size_t numSize = slash != nullptr ? size_t(slash - str) : size;
+
+   if( !canonicalInteger(str, numSize, true) )
+   {
+      writeString(str, size);
+      return;
+   }
+
+   if( slash == nullptr )
+   {
+      // at most 18 digits always fit into int64_t
+      if( numSize <= 18 )
+         writeInteger(strtoll(str, nullptr, 10));
+      else
+      {
+         _scratch.get_num().set_str(std::string(str, size), 10);
+         _scratch.get_den() = 1;
+         writeRational(_scratch);
+      }
+      return;
+   }
+
+   const char* den = slash + 1;
+   size_t denSize = size - numSize - 1;
+
+   if( !canonicalInteger(den, denSize, false) || (denSize == 1 && *den <= '1') || *str == '0' )
+   {
+      writeString(str, size);
+      return;
+   }
+
+   _scratch.get_num().set_str(std::string(str, numSize), 10);
+   _scratch.get_den().set_str(std::string(den, denSize), 10);
+
+   mpz_class gcd;
+   mpz_gcd(gcd.get_mpz_t(), _scratch.get_num_mpz_t(), _scratch.get_den_mpz_t());
+
+   if( gcd == 1 )
+      writeRational(_scratch);
+   else
+      writeString(str, size);
+}
+
+
+// Writes the section table and the offset of the END item, and flushes the stream
+inline bool BinaryWriter::finish()
+{
+   uint64_t end = bytesWritten();
+
+   _header(BinaryItem::END, _sections.size());
+   for( auto &section : _sections )
+   {
+      _varint(section.first.size());
+      _buffer.append(section.first);
+      _varint(section.second);
+   }
+
+   for( int i = 0; i < 8; ++i )
+      _buffer.push_back(char((end >> (8 * i)) & 0xff));
+
+   _flush();
+   _out.flush();
+
+   return !_out.fail();
+}
+
+#endif
@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <map>
 #include <vector>
@@ -34,6 +35,26 @@
 #include <ctime>
 #include <chrono>
 #include <memory>
+#include <cstring>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+#include <limits>
+#include "viprio.h"
+#include "viprrational.h"
+#include "vipraccum.h"
+#include "viprindex.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VIPR_HAVE_RUSAGE
+#include <sys/resource.h>
+#endif
 
 
 // Version control
@@ -45,14 +66,20 @@ using std::map;
 using std::string;
 using std::shared_ptr;
 using std::vector;
-using std::ifstream;
 using std::make_shared;
 using std::cerr;
 using std::endl;
 using std::cout;
 
 // Types
-typedef map<int, bool> SVectorBool;
+// Number type of all coefficients, sides and multipliers.  Defining VIPR_GMP_RATIONAL
+// uses plain GMP rationals, e.g., for comparison
+#if defined(VIPR_HAVE_HYBRID_RATIONAL) && !defined(VIPR_GMP_RATIONAL)
+typedef HybridRational Rational;
+#else
+typedef mpq_class Rational;
+#endif
+
 
 // The type of derivation used to derive a constraint
 enum DerivationType
@@ -72,66 +99,152 @@ enum RelationToProveType
    RANGE   // lower bound (-inf if none) and upper bound (inf if none) to be verified
 };
 
+// When to compute the last use of each constraint by a pre-scan of the DER section
+enum PrescanMode
+{
+   OFF,    // use the last-use indices of the certificate
+   ON,     // always pre-scan
+   AUTO    // pre-scan if the first derivation has no last-use index, i.e., -1
+};
+
+// How lin/rnd derivations sum up the multiples of their rows
+enum LinCombKernel
+{
+   RATIONAL_SUMS,      // one rational per variable, canonicalized after every addition
+   COMMON_DENOMINATOR  // integer numerators over one denominator, canonicalized at the end
+};
+
 
 // Classes
-// Sparse vectors of rational numbers as maps
-class SVectorGMP : public map<int, mpq_class>
+// Sparse vectors of rational numbers stored as an array of increasing indices and an array of
+// the corresponding values.  Entries may be appended in any order; compactify() sorts them,
+// keeps the last value for repeated indices and removes zeros
+template <class T>
+class SparseVector
 {
    public:
-      void compactify() {  if( !_compact )
-                           {
-                              auto it = this->begin();
-                              while( it != this->end() )
-                              {
-                                 if( it->second == 0 ) this->erase(it++);
-                                 else ++it;
-                              }
-                              _compact = true;
-                           }
-                        }
-      bool operator!=(SVectorGMP &other);
-      bool operator==(SVectorGMP &other) { return !(*this != other);}
-      SVectorGMP operator-(const SVectorGMP &other)
-      {
-         SVectorGMP returnsvec(*this);
-         for(auto it = other.begin(); it != other.end(); ++it)
-         {
-            returnsvec[it->first] -= it->second;
-         }
+      size_t size() const { return _indices.size(); }
+      int index(size_t k) const { return _indices[k]; }
+      const T& value(size_t k) const { return _values[k]; }
 
-         return returnsvec;
-      }
+      void clear() { _indices.clear(); _values.clear(); _compact = true; _hashed = false; }
+      void reserve(size_t n) { _indices.reserve(n); _values.reserve(n); }
+      T& append(int index) { _indices.push_back(index); _values.emplace_back();
+                                     _compact = false; _hashed = false; return _values.back(); }
+      void append(int index, const T &value) { append(index) = value; }
+
+      void compactify() { if( !_compact ) _sort(); }
+      T operator[](int index) const; // zero if index is not in the support
+
+      // comparison and difference of compact vectors
+      bool operator!=(const SparseVector &other) const;
+      bool operator==(const SparseVector &other) const { return !(*this != other);}
+      SparseVector operator-(const SparseVector &other) const;
+
+      // content hash of the compact vector; vectors that know their hashes compare them first
+      uint64_t hash();
+      size_t memoryUsage() const; // bytes used by entries and GMP limbs
+
+   private:
+      void _sort();
+
+      vector<int> _indices;
+      vector<T> _values;
+      bool _compact = true;
+      bool _hashed = false;
+      uint64_t _hash = 0;
+};
+
+typedef SparseVector<Rational> SVectorGMP;
+
+// Interning table for coefficient rows.  A row with the same content as a row read before is
+// replaced by the stored one, such that repeated rows (objective, branching rows, bounds) share
+// one allocation and compare equal by pointer.  The table only holds weak references and does
+// not keep rows of trashed constraints alive
+class RowTable
+{
+   public:
+      shared_ptr<SVectorGMP> intern(const shared_ptr<SVectorGMP> &row);
+
+      long numberOfRows() const { return _numberOfRows; }
+      long numberOfUniqueRows() const { return _numberOfUniqueRows; }
+      size_t bytesSaved() const { return _bytesSaved; }
+
+   private:
+      void _sweep(); // removes entries of released rows
+
+      std::unordered_multimap<uint64_t, std::weak_ptr<SVectorGMP>> _rows;
+      size_t _sweepSize = 1024;
+      long _numberOfRows = 0;
+      long _numberOfUniqueRows = 0;
+      size_t _bytesSaved = 0;
+};
+
+// Immutable sorted sets of indices of assumption constraints.  Sets are hash-consed, i.e.,
+// equal sets share one allocation, so copies are pointer copies and equality is a pointer
+// comparison.  The empty set needs no allocation at all
+class AssumptionSet
+{
+   public:
+      AssumptionSet() {}
+      static AssumptionSet singleton(int index);
+
+      bool empty() const { return !_node; }
+      size_t size() const { return _node ? _node->indices.size() : 0; }
+      const int* begin() const { return _node ? _node->indices.data() : nullptr; }
+      const int* end() const { return _node ? _node->indices.data() + size() : nullptr; }
+      bool contains(int index) const { return std::binary_search(begin(), end(), index); }
+
+      AssumptionSet unite(const AssumptionSet &other) const;
+      AssumptionSet erase(int index) const;
+
+      bool operator==(const AssumptionSet &other) const { return _node == other._node; }
+      bool operator!=(const AssumptionSet &other) const { return _node != other._node; }
 
    private:
-      bool _compact = false;
+      struct Node
+      {
+         vector<int> indices;
+         size_t hash;
+      };
+      struct NodeHash { size_t operator()(const Node *n) const { return n->hash; } };
+      struct NodeEqual { bool operator()(const Node *a, const Node *b) const
+                         { return a->indices == b->indices; } };
+      typedef std::unordered_map<const Node*, std::weak_ptr<const Node>, NodeHash, NodeEqual> Table;
+
+      static AssumptionSet _intern(vector<int> &indices);
+      static void _release(const Node *node);
+
+      static Table _table; // all sets alive, keyed by their content
+      static std::mutex _tableMutex;
+
+      shared_ptr<const Node> _node;
 };
 
 // Constraint format
-class Constraint
+template <class T>
+class LinearConstraint
 {
    public:
-      Constraint() {}
+      LinearConstraint() {}
 
-      Constraint( const string label, const int sense, const mpq_class rhs,
-                  shared_ptr<SVectorGMP> coefficients, const bool isAssumptionCon,
-                  const SVectorBool assumptionList):
+      LinearConstraint( const string label, const int sense, const T rhs,
+                  shared_ptr<SparseVector<T>> coefficients, const bool isAssumptionCon,
+                  const AssumptionSet assumptionList):
 
                   _label(label), _sense(sense), _rhs(rhs), _coefficients(coefficients),
                   _isAssumption(isAssumptionCon), _assumptionList(assumptionList)
                   {
                      _coefficients->compactify();
-                     _trashed = false;
                      _falsehood = _isFalsehood();
                   }
 
-      bool round();
+      bool round(std::ostream &errors);
 
-      mpq_class getRhs() const { return _rhs; }
-      mpq_class getCoef(const int index) { if( _coefficients->find(index) != _coefficients->end() )
-                                              return (*_coefficients)[index];
-                                           else return mpq_class(0); }
+      T getRhs() const { return _rhs; }
+      T getCoef(const int index) const { return (*_coefficients)[index]; }
 
-      shared_ptr<SVectorGMP> coefSVec() const { return _coefficients; }
+      shared_ptr<SparseVector<T>> coefSVec() const { return _coefficients; }
 
       int getSense() const { return _sense; }
 
@@ -143,33 +256,29 @@ class Constraint
       bool isTautology();
                   // true iff the constraint is a tautology like 0 <= 1
 
-      bool hasAsm(const int index) {
-               return (_assumptionList.find(index) != _assumptionList.end());
-            }
+      bool hasAsm(const int index) const { return _assumptionList.contains(index); }
 
-      void setassumptionList(const SVectorBool assumptionList) { _assumptionList = assumptionList; }
-      SVectorBool getassumptionList() const { return _assumptionList; }
+      void setassumptionList(const AssumptionSet &assumptionList) { _assumptionList = assumptionList; }
+      const AssumptionSet& getassumptionList() const { return _assumptionList; }
 
-      bool dominates(Constraint &other) const;
+      bool dominates(const LinearConstraint &other) const;
       void print();
 
-      void trash() { _trashed = true; _falsehood = false; _coefficients = nullptr;
-                     _rhs = 0; _assumptionList.clear(); }
-      bool isTrashed() const { return _trashed; }
+      // whether sense <= | = | >= rhs implies otherSense otherRhs for the same row, and whether
+      // it is a contradiction for the empty row
+      static bool impliesRhs(int sense, const T &rhs, int otherSense, const T &otherRhs);
+      static bool isContradiction(int sense, const T &rhs);
 
       string label() const { return _label; }
 
       void setMaxRefIdx(int refIdx) { _refIdx = refIdx; }
       int getMaxRefIdx() { return _refIdx; }
 
-      Constraint operator-(const Constraint& other)
+      LinearConstraint operator-(const LinearConstraint& other)
       {
-         Constraint returncons(*this);
-         for(auto it = other._coefficients->begin(); it != other._coefficients->end(); ++it)
-         {
-            (*returncons._coefficients)[it->first] -= it->second;
-         }
+         LinearConstraint returncons(*this);
 
+         returncons._coefficients = make_shared<SparseVector<T>>(*_coefficients - *other._coefficients);
          returncons._rhs -= other._rhs;
          return returncons;
       }
@@ -177,36 +286,273 @@ class Constraint
    private:
       string _label;
       int _sense;
-      mpq_class _rhs;
-      shared_ptr<SVectorGMP> _coefficients;
+      T _rhs;
+      shared_ptr<SparseVector<T>> _coefficients;
       int _refIdx = -1;
       bool _isAssumption;
-      SVectorBool _assumptionList; // constraint index list that are assumptions
+      AssumptionSet _assumptionList; // constraint index list that are assumptions
       bool _falsehood;
 
       bool _isFalsehood();
-      bool _trashed;
+};
+
+typedef LinearConstraint<Rational> Constraint;
+
+// The rows of the CON section in compressed sparse row form, such that solutions are checked
+// against one contiguous copy of the constraint matrix
+struct ConstraintMatrix
+{
+   vector<size_t> rowStart{0};   // row j has the entries rowStart[j] to rowStart[j + 1] - 1
+   vector<int> columns;
+   vector<Rational> values;
+   vector<int> sense;
+   vector<Rational> rhs;
+};
+
+// Result of checking a solution, or some of its rows, against the constraint matrix
+struct SolutionCheck
+{
+   Rational maxViolation = 0;    // largest violation of a row, 0 if all rows are satisfied
+   int violatedRow = -1;         // smallest index of a violated row
+   double seconds = 0.0;         // time spent on the rows, summed over the threads
+};
+
+// A constraint referenced by a lin/rnd derivation together with its multiplier
+struct LinCombTerm
+{
+   Rational multiplier;
+   shared_ptr<SVectorGMP> coefficients;
+   Rational rhs;
+};
+
+// Everything needed to check the arithmetic of a lin/rnd derivation.  The referenced rows are
+// held by shared pointers, so the check is independent of the constraint store and of released
+// constraints and can be run on any thread
+struct LinCombCheck
+{
+   int index;                    // index of the derived constraint
+   DerivationType type;          // LIN or RND
+   int sense;                    // sense of the linear combination
+   vector<LinCombTerm> terms;    // multipliers and referenced rows
+   string label;                 // the constraint stated in the certificate
+   int statedSense;
+   Rational statedRhs;
+   shared_ptr<SVectorGMP> statedCoefficients;
+   string errors;                // messages of a failed check, printed by the thread reporting it
+};
+
+// A derivation as read from the certificate.  Its references to other constraints are not
+// resolved yet, so records can be read ahead of the check on another thread.  If reading
+// fails, the record holds everything read before the failure, such that errors are reported
+// in the same order as when reading and checking alternate
+struct DerivationRecord
+{
+   string label;
+   int sense = 0;
+   Rational rhs;
+   shared_ptr<SVectorGMP> coefficients;
+   string bracket;               // opening bracket
+   string kind;
+   DerivationType type = DerivationType::UNKNOWN;
+   vector<int> indices;          // lin/rnd: constraint indices of the multipliers
+   vector<Rational> multipliers; // lin/rnd: multipliers, reused between records
+   size_t numberOfMultipliers = 0;
+   int unsplit[4];               // uns: con1 asm1 con2 asm2
+   string closing;               // closing bracket
+   int refIdx = -1;
+   bool constraintRead = false;  // label, sense, rhs and coefficients were read
+   bool referencesRead = false;  // multipliers or unsplit indices were read
+   std::ostringstream errors;    // messages of a failed constraint read
+};
+
+// Live constraints by index.  A constraint is released completely once the derivation given as
+// its last use (its maximum reference index) has been processed, so memory is proportional to
+// the number of live constraints rather than to the length of the certificate.  Only the labels
+// of released assumptions are kept, for reporting undischarged assumptions
+class ConstraintStore
+{
+   public:
+      int size() const { return _size; } // number of constraints added, including released ones
+      int add(const Constraint &con);    // returns the index of the new constraint
+      void skipTo(int index) { _size = std::max(_size, index); } // leaves the indices before unknown
+
+      Constraint* find(int index);       // nullptr if the index is unknown or released
+      Constraint& operator[](int index) { Constraint* con = find(index); assert(con); return *con; }
+      Constraint& back() { return (*this)[_size - 1]; }
+      string label(int index) const;
+
+      void release(int index);
+      void releaseIfLastUse(int index, int current); // if current is the last use of index
+
+      size_t numberOfLive() const { return _live.size(); }
+      size_t peakLive() const { return _peakLive; }
+
+   private:
+      std::unordered_map<int, Constraint> _live;
+      std::unordered_map<int, string> _releasedAssumptions;
+      int _size = 0;
+      size_t _peakLive = 0;
+};
+
+// Pool of worker threads checking lin/rnd derivations.  Submission blocks while the queue is
+// full, so the parser never runs far ahead of the workers.  If several checks fail, the one
+// with the smallest index is reported, and only if no derivation checked by the calling thread
+// failed before it
+class CheckPool
+{
+   public:
+      CheckPool(int numberOfWorkers);
+      ~CheckPool();
+
+      void submit(shared_ptr<LinCombCheck> check);
+      // waits for all submitted checks; true iff all checks of constraints before the given index
+      // succeeded, otherwise the earliest failure is reported
+      bool finish(int before = std::numeric_limits<int>::max());
+      bool hasFailed() const { return _failed; }
+
+   private:
+      void _work();
+
+      std::mutex _mutex;
+      std::condition_variable _hasWork;
+      std::condition_variable _hasRoom;
+      std::condition_variable _isIdle;
+      std::deque<shared_ptr<LinCombCheck>> _queue;
+      vector<std::thread> _workers;
+      size_t _capacity;
+      int _busy = 0;
+      bool _stop = false;
+      std::atomic<bool> _failed;
+      shared_ptr<LinCombCheck> _failedCheck;
+      shared_ptr<Constraint> _failedDerived;
+};
+
+// Bounded lock-free queue of derivation records between exactly one producer, the tokenizer
+// thread, and one consumer, the verifier.  The records live in a ring and are filled in place,
+// so their strings, vectors and rationals keep their storage.  Both sides spin briefly and then
+// sleep while waiting; the waiting times and the average number of queued records show which
+// side limits the throughput
+class DerivationQueue
+{
+   public:
+      DerivationQueue(size_t capacity) : _ring(capacity) {}
+
+      // producer
+      DerivationRecord* slot();  // waits for a free slot; nullptr if the consumer stopped
+      void push();               // publishes the record in the slot
+      void close();              // no more records follow
+
+      // consumer
+      DerivationRecord* front(); // waits for the next record; nullptr if there is none
+      void pop();
+      void stop();               // the producer shall stop
+
+      size_t capacity() const { return _ring.size(); }
+      double averageOccupancy() const { return _pops > 0 ? double(_occupancy) / _pops : 0.0; }
+      double producerWait() const { return _producerWait; }
+      double consumerWait() const { return _consumerWait; }
+
+   private:
+      static void _backoff(int &round);
+
+      vector<DerivationRecord> _ring;
+      std::atomic<size_t> _head{0};     // number of records pushed
+      std::atomic<size_t> _tail{0};     // number of records popped
+      std::atomic<bool> _closed{false};
+      std::atomic<bool> _stopped{false};
+      double _producerWait = 0.0;       // written by the producer only
+      double _consumerWait = 0.0;       // written by the consumer only
+      size_t _occupancy = 0;            // sum of the queue lengths seen by front()
+      size_t _pops = 0;
+};
+
+// Parses the DER section of a mapped text certificate on several threads.  The section is
+// processed in windows, and each window is split into one chunk per thread at derivation
+// boundaries found by the terminator pattern "} <index>".  Such a guess is confirmed if the
+// chunk before it, which starts at a confirmed boundary, ends exactly there; otherwise the rest
+// of the window is parsed sequentially.  A producer thread parses the next windows while the
+// verifier consumes the records of the current one in order
+class ChunkedReader
+{
+   public:
+      ChunkedReader(const char* begin, const char* end, int numberOfThreads);
+      ~ChunkedReader() { stop(); }
+
+      DerivationRecord* next(); // next record in order; nullptr if there is none
+      void stop();              // stops the producer and waits for it
+
+      // valid after stop()
+      const char* parsedEnd() const { return _parsedEnd; }
+      long numberOfChunks() const { return _numberOfChunks; }
+      long numberOfFallbacks() const { return _numberOfFallbacks; }
+
+      double consumerWait() const { return _consumerWait; }
+
+   private:
+      typedef std::deque<DerivationRecord> Chunk;
+      typedef vector<shared_ptr<Chunk>> Window;
+
+      static const size_t _windowSize = 16 << 20;
+      static const size_t _queueSize = 2; // windows parsed ahead of the verifier
+
+      void _run();
+      const char* _parseChunk(const char* start, const char* stop, Chunk &chunk, bool &failed) const;
+      const char* _findBoundary(const char* p) const;
+      const char* _skipSpace(const char* p) const;
+
+      const char* _begin;
+      const char* _end;
+      int _numberOfThreads;
+      std::thread _producer;
+      std::mutex _mutex;
+      std::condition_variable _changed;
+      std::deque<Window> _queue;
+      bool _done = false;
+      bool _stopRequested = false;
+      Window _current;                  // window consumed by the verifier
+      size_t _chunkIndex = 0;
+      size_t _recordIndex = 0;
+      const char* _parsedEnd;           // end of the windows handed to the verifier
+      long _numberOfChunks = 0;
+      long _numberOfFallbacks = 0;
+      double _consumerWait = 0.0;
 };
 
 
 // Globals
-const SVectorBool emptyList;
+AssumptionSet::Table AssumptionSet::_table; // defined before all constraints, which use it
+std::mutex AssumptionSet::_tableMutex;
+const AssumptionSet emptyList;
 
 int numberOfVariables = 0; // number of variables
 int numberOfConstraints = 0; // number of constraints
 int numberOfBounds = 0; // number of bounds
 int numberOfDerivations = 0; // number od derivations
 int numberOfSolutions = 0; // number of solutions
+int numberOfThreads = 1; // threads used for checking derivations
+bool usePipeline = false; // read derivations on a separate thread while checking them
+int numberOfParseThreads = 1; // threads parsing chunks of the DER section
+const size_t pipelineCapacity = 256; // derivation records queued between the threads
+PrescanMode prescanMode = PrescanMode::AUTO; // when to compute last uses by a pre-scan
+LinCombKernel linCombKernel = LinCombKernel::RATIONAL_SUMS; // arithmetic of lin/rnd checks
+const char* certificateFileName = nullptr;
+CertificateIndex certificateIndex; // offsets and references of the derivations, if available
+bool haveIndex = false;
+int firstDerivation = 0; // range of derivations to check, all if lastDerivation < 0
+double followTimeout = -1.0; // follow a growing certificate for up to this many idle seconds
+const double progressInterval = 5.0; // seconds between progress reports when following
+int lastDerivation = -1;
 vector<bool> isInt; // integer variable indices
 vector<string> variable; // variable names
-vector<Constraint> constraint; // all the constraints, including derived ones
+ConstraintStore constraint; // live constraints, including derived ones
 vector<SVectorGMP> solution; // all the solutions for checking feasibility
-ifstream certificateFile;   // certificate file stream
+RowTable rowTable; // shared coefficient rows of constraints
+CertificateInput certificateFile;   // certificate file tokenizer
 
 RelationToProveType relationToProveType;
-mpq_class bestObjectiveValue; // best objective function value of specified solutions
-mpq_class lowerBound; // lower bound for optimal value to be checked
-mpq_class upperBound; // upper bound for optimal value to be checked
+Rational bestObjectiveValue; // best objective function value of specified solutions
+Rational lowerBound; // lower bound for optimal value to be checked
+Rational upperBound; // upper bound for optimal value to be checked
 string lowerStr, upperStr;
 bool isMin; // is minimization problem
 bool checkLower; // true iff need to verify lower bound
@@ -227,44 +573,184 @@ bool processRTP();
 bool processSOL();
 bool processDER();
 
-bool readMultipliers(int &sense, SVectorGMP &mult);
-bool readConstraintCoefficients(shared_ptr<SVectorGMP> &v);
-bool readConstraint( string &label, int &sense, mpq_class &rhs,
-                     shared_ptr<SVectorGMP> &coef);
+bool resolveMultipliers(const DerivationRecord &record, int &sense, SVectorGMP &mult,
+                        std::ostream &errors);
+bool readConstraintCoefficients(CertificateInput &in, shared_ptr<SVectorGMP> &v, std::ostream &errors);
+bool readConstraint( CertificateInput &in, string &label, int &sense, Rational &rhs,
+                     shared_ptr<SVectorGMP> &coef, std::ostream &errors);
+bool readDerivation( CertificateInput &in, DerivationRecord &record );
+void readDerivations( DerivationQueue &queue );
+bool checkDerivation( DerivationRecord &record, bool isLast, CheckPool* pool,
+                      const vector<int>* lastUse, std::ostream &errors );
 
 inline mpq_class floor(const mpq_class &q); // rounding down
 inline mpq_class ceil(const mpq_class &q); // rounding up
 bool isInteger(const mpq_class &q); // check if variable is integer
 
-mpq_class scalarProduct(shared_ptr<SVectorGMP> u, shared_ptr<SVectorGMP> v);
-
-bool canUnsplit(  Constraint &toDer, const int con1, const int a1, const int con2,
-                  const int a2, SVectorBool &assumptionList);
-
-bool readLinComb( int &sense, mpq_class &rhs, shared_ptr<SVectorGMP> coef,
-                  int currConIdx, SVectorBool &amsList);
+Rational scalarProduct(shared_ptr<SVectorGMP> u, shared_ptr<SVectorGMP> v);
+void buildConstraintMatrix( ConstraintMatrix &matrix );
+void checkRows( const ConstraintMatrix &matrix, const vector<Rational> &x, int first, int last,
+                SolutionCheck &result );
+void checkSolutions( const ConstraintMatrix &matrix, const vector<shared_ptr<SVectorGMP>> &solutions,
+                     vector<SolutionCheck> &results );
+
+bool canUnsplit(  const Constraint &toDer, const int con1, const int a1, const int con2,
+                  const int a2, AssumptionSet &assumptionList, std::ostream &errors);
+
+bool resolveLinComb( const DerivationRecord &record, LinCombCheck &check, int currConIdx,
+                     AssumptionSet &amsList, std::ostream &errors);
+bool scanLastUses( size_t offset, vector<int> &lastUse );
+bool indexLastUses( vector<int> &lastUse );
+bool checkDerivationRange( int first, int last );
+double peakResidentMegabytes();
+void sumRational( const LinCombCheck &check, DenseAccumulator<Rational> &combination, Rational &rhsDer );
+void sumCommonDenominator( const LinCombCheck &check, CommonDenominatorAccumulator &combination );
+bool checkLinComb( LinCombCheck &check, shared_ptr<Constraint> &failed );
+void printFailedLinComb( LinCombCheck &check, Constraint &derived );
 
 // Main function
 int main(int argc, char *argv[])
 {
 
    int returnStatement = -1;
+   bool buildIndex = false;
+
+   for( int i = 1; i < argc; ++i )
+   {
+      string option = argv[i];
+
+      if( option.compare(0, 10, "--threads=") == 0 || (option == "--threads" && i + 1 < argc) )
+      {
+         string value = (option == "--threads") ? argv[++i] : option.substr(10);
+
+         numberOfThreads = atoi(value.c_str());
+         if( numberOfThreads <= 0 )
+            numberOfThreads = std::max(1, int(std::thread::hardware_concurrency()));
+      }
+      else if( option == "--pipeline" )
+         usePipeline = true;
+      else if( option.compare(0, 16, "--parse-threads=") == 0 )
+      {
+         numberOfParseThreads = atoi(option.substr(16).c_str());
+         if( numberOfParseThreads <= 0 )
+            numberOfParseThreads = std::max(1, int(std::thread::hardware_concurrency()));
+      }
+      else if( option == "--prescan" || option == "--prescan=on" )
+         prescanMode = PrescanMode::ON;
+      else if( option == "--prescan=off" )
+         prescanMode = PrescanMode::OFF;
+      else if( option == "--prescan=auto" )
+         prescanMode = PrescanMode::AUTO;
+      else if( option == "--index" )
+         buildIndex = true;
+      else if( option == "--kernel=rational" )
+         linCombKernel = LinCombKernel::RATIONAL_SUMS;
+      else if( option == "--kernel=common" )
+         linCombKernel = LinCombKernel::COMMON_DENOMINATOR;
+      else if( option == "--follow" )
+         followTimeout = 60.0;
+      else if( option.compare(0, 9, "--follow=") == 0 )
+         followTimeout = std::max(0.0, atof(option.substr(9).c_str()));
+      else if( option.compare(0, 14, "--derivations=") == 0 && option.find(':') != string::npos )
+      {
+         firstDerivation = atoi(option.substr(14).c_str());
+         lastDerivation = atoi(option.substr(option.find(':') + 1).c_str());
+         if( firstDerivation < 0 || lastDerivation < firstDerivation )
+         {
+            certificateFileName = nullptr;
+            break;
+         }
+      }
+      else if( (option[0] != '-' || option == "-") && certificateFileName == nullptr )
+      {
+         certificateFileName = argv[i];
+      }
+      else
+      {
+         certificateFileName = nullptr;
+         break;
+      }
+   }
 
-   if( argc != 2 )
+   if( certificateFileName == nullptr )
    {
-      cerr << "Usage: " << argv[0] << " <certificate filename>\n";
+      cerr << "Usage: " << argv[0] << " [options] <certificate filename>\n"
+           << "The certificate is read from standard input if the filename is -, and may also be a\n"
+           << "named pipe, so it can be checked while it is written.\n"
+           << "  --threads=<n>   check solutions and lin/rnd derivations on n threads\n"
+           << "                  (0: all cores)\n"
+           << "  --prescan=<m>   compute the last use of each constraint by a pre-scan of the DER\n"
+           << "                  section: on, off or auto (default, if the certificate has none)\n"
+           << "  --pipeline      read ahead and tokenize derivations on separate threads\n"
+           << "  --kernel=<k>    sum lin/rnd derivations as rationals (rational, default) or as\n"
+           << "                  integers over a common denominator (common)\n"
+           << "  --parse-threads=<n>  parse chunks of the DER section on n threads (0: all cores),\n"
+           << "                  for uncompressed text certificates\n"
+           << "  --index         write the index <certificate filename>.idx unless it is up to date\n"
+           << "  --derivations=<first>:<last>  check only these derivations, counted from 0,\n"
+           << "                  located through the index\n"
+           << "  --follow[=<s>]  check a certificate that is still being written: at its end, wait\n"
+           << "                  until it grows, <certificate filename>.done exists or nothing was\n"
+           << "                  appended for s seconds (default 60)\n";
       return returnStatement;
    }
 
-   certificateFile.open(argv[1]);
+   if( followTimeout >= 0.0 )
+      certificateFile.follow(followTimeout, string(certificateFileName) + ".done");
+
+   certificateFile.open(certificateFileName);
+
+   // a followed certificate may not have been created yet
+   auto openStart = std::chrono::steady_clock::now();
+
+   while( certificateFile.fail() && followTimeout >= 0.0
+      && std::chrono::duration<double>(std::chrono::steady_clock::now() - openStart).count() < followTimeout )
+   {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      certificateFile.open(certificateFileName);
+   }
 
    if( certificateFile.fail() )
    {
-      cerr << "Failed to open file " << argv[1] << endl;
+      cerr << "Failed to open file " << certificateFileName << endl;
       return returnStatement;
    }
 
+   // An up-to-date index replaces the pre-scan and locates derivations for range checks
+   haveIndex = !certificateFile.isStream() && certificateIndex.load(certificateFileName);
+
+   if( haveIndex )
+      cout << "Using index " << CertificateIndex::fileName(certificateFileName) << endl;
+   else if( (buildIndex || lastDerivation >= 0) && certificateFile.isStream() )
+      cout << "Cannot index a certificate read from a stream" << endl;
+   else if( buildIndex || lastDerivation >= 0 )
+   {
+      auto start = std::chrono::steady_clock::now();
+
+      haveIndex = certificateIndex.build(certificateFileName);
+
+      std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+      if( !haveIndex )
+         cout << "Failed to index the certificate" << endl;
+      else
+      {
+         cout << "Indexed " << certificateIndex.numberOfDerivations() << " derivations in "
+              << duration.count() << " seconds" << endl;
+
+         if( buildIndex && !certificateIndex.save(certificateFileName) )
+            cerr << "Failed to write index " << CertificateIndex::fileName(certificateFileName) << endl;
+      }
+   }
+
+   if( lastDerivation >= 0 && !haveIndex )
+      return returnStatement;
+
+   if( usePipeline && lastDerivation < 0 )
+      certificateFile.startReadAhead();
+
    double start_cpu_tm = clock();
+   auto start_wall_tm = std::chrono::steady_clock::now();
    if( processVER() )
       if( processVAR() )
          if( processINT() )
@@ -281,6 +767,20 @@ int main(int argc, char *argv[])
                                 << " seconds (CPU)" << endl;
                         }
 
+   std::chrono::duration<double> wall_dur = std::chrono::steady_clock::now() - start_wall_tm;
+   double megabytes = certificateFile.bytesRead() / 1e6;
+
+   cout << std::setprecision(6) << "Read " << megabytes << " MB "
+        << (certificateFile.isBinary() ? "(binary) " : "")
+        << (certificateFile.isMapped() ? "(mapped) " : "")
+        << (certificateFile.isStream() ? "(stream) " : "") << "in " << wall_dur.count()
+        << " seconds (wall), " << megabytes / wall_dur.count() << " MB/s" << endl;
+   cout << "Interned " << rowTable.numberOfRows() << " coefficient rows: "
+        << rowTable.numberOfUniqueRows() << " unique, " << rowTable.bytesSaved() / 1e6
+        << " MB saved" << endl;
+   cout << "Peak live constraints " << constraint.peakLive() << " of " << constraint.size()
+        << ", peak RSS " << peakResidentMegabytes() << " MB" << endl;
+
    return returnStatement;
 }
 
@@ -322,15 +822,20 @@ bool processVER()
    for( ;; )
    {
       certificateFile >> tmpStr;
-      if( tmpStr == "VER" )
+      if( certificateFile.fail() )
+      {
+         cerr << "Failed to read VER" << endl;
+break;
+      }
+      else if( tmpStr == "VER" )
       {
          certificateFile >> tmpStr;
          returnStatement = checkVersion(tmpStr);
 break;
       }
-      else if( tmpStr == "%" )
+      else if( tmpStr[0] == '%' )
       {
-         getline(certificateFile, tmpStr);
+         certificateFile.skipLine();
       }
       else
       {
@@ -442,7 +947,7 @@ bool processINT()
 
             for( int i = 0; i < numberOfIntegers; ++i )
             {
-               int index;
+               int index = -1;
 
                certificateFile >> index;
                if( certificateFile.fail() )
@@ -450,6 +955,11 @@ bool processINT()
                   cerr << "Error reading integer index " << i << endl;
             goto TERMINATE;
                }
+               else if( index < 0 || index >= numberOfVariables )
+               {
+                  cerr << "Index out of bounds: " << index << endl;
+                  goto TERMINATE;
+               }
                isInt[index] = true;
             }
          }
@@ -501,12 +1011,13 @@ bool processOBJ()
           goto TERMINATE;
       }
 
-      returnStatement = readConstraintCoefficients(objectiveCoefficients);
+      returnStatement = readConstraintCoefficients(certificateFile, objectiveCoefficients, cerr);
+      objectiveCoefficients = rowTable.intern(objectiveCoefficients);
       objectiveIntegral = true;
 
-      for( auto it = objectiveCoefficients->begin(); it != objectiveCoefficients->end(); ++it )
+      for( size_t k = 0; k < objectiveCoefficients->size(); ++k )
       {
-         if ( !isInteger(it->second) || !isInt[it->first] )
+         if ( !isInteger(objectiveCoefficients->value(k)) || !isInt[objectiveCoefficients->index(k)] )
             objectiveIntegral = false;
       }
 
@@ -556,17 +1067,19 @@ bool processCON()
       {
          string label;
          int sense;
-         mpq_class rhs;
+         Rational rhs;
 
          for( int i = 0; i < numberOfConstraints; i++ )
          {
             shared_ptr<SVectorGMP> coef(make_shared<SVectorGMP>());
 
-            returnStatement = readConstraint(label, sense, rhs, coef);
+            returnStatement = readConstraint(certificateFile, label, sense, rhs, coef, cerr);
 
             if( !returnStatement ) break;
 
-            constraint.push_back(Constraint(label, sense, rhs, coef, false, emptyList));
+            coef = rowTable.intern(coef);
+
+            constraint.add(Constraint(label, sense, rhs, coef, false, emptyList));
          }
       }
    }
@@ -624,13 +1137,13 @@ bool processRTP()
          if( lowerStr != "-inf" )
          {
             checkLower = true;
-            lowerBound = mpq_class(lowerStr);
+            lowerBound = Rational(mpq_class(lowerStr));
          }
 
          if( upperStr != "inf" )
          {
             checkUpper = true;
-            upperBound = mpq_class(upperStr);
+            upperBound = Rational(mpq_class(upperStr));
          }
 
 
@@ -681,7 +1194,7 @@ bool processSOL()
    cout << endl << "Processing SOL section..." << endl;
 
    bool returnStatement = false;
-   mpq_class value;
+   Rational value;
 
    string section, label;
 
@@ -706,68 +1219,71 @@ bool processSOL()
    }
    else
    {
-      auto satisfies = [] (Constraint &con, shared_ptr<SVectorGMP> &x)
+      vector<string> labels(numberOfSolutions);
+      vector<shared_ptr<SVectorGMP>> solutions;
+      std::ostringstream readErrors;
+
+      // read all solutions first, so that they are checked together; a read error is reported
+      // in order after the solutions before it
+      for( int i = 0; i < numberOfSolutions; ++i )
       {
-         bool returnStat = false;
+         shared_ptr<SVectorGMP> solution(make_shared<SVectorGMP>());
 
-         mpq_class prod = scalarProduct(con.coefSVec(), x);
+         certificateFile >> labels[i];
+         if( !readConstraintCoefficients(certificateFile, solution, readErrors) )
+            break;
+         solutions.push_back(solution);
+      }
 
-         if( con.getSense() < 0 )
-         {
-            returnStat = (prod <= con.getRhs());
-         }
-         else if( con.getSense() > 0 )
-         {
-            returnStat = (prod >= con.getRhs());
-         }
-         else
-         {
-            returnStat = (con.getRhs() == prod);
-         }
+      ConstraintMatrix matrix;
+      vector<SolutionCheck> results;
+      auto start = std::chrono::steady_clock::now();
 
-         return returnStat;
-      };
+      buildConstraintMatrix(matrix);
+      checkSolutions(matrix, solutions, results);
 
-      shared_ptr<SVectorGMP> solutionSpecified(make_shared<SVectorGMP>());
-      vector<mpq_class> sol(numberOfVariables);
+      std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+      if( !solutions.empty() )
+      {
+         cout << "Checked " << solutions.size() << " solutions against " << matrix.sense.size()
+              << " constraints on " << numberOfThreads << " threads in " << duration.count()
+              << " seconds" << endl;
+      }
 
       for( int i = 0; i < numberOfSolutions; ++i )
       {
-         certificateFile >> label;
-         cout << "checking solution " << label << endl;
+         cout << "checking solution " << labels[i] << endl;
 
-         if( !readConstraintCoefficients(solutionSpecified) )
+         if( size_t(i) == solutions.size() )
          {
+            cerr << readErrors.str();
             cerr << "Failed to read solution." << endl;
             goto TERMINATE;
          }
-         else
+
+         shared_ptr<SVectorGMP> &solutionSpecified = solutions[i];
+
+         // Check integrality constraints
+         for( size_t k = 0; k < solutionSpecified->size(); ++k )
          {
-            for( int j = 0; j < numberOfVariables; ++j )
-            {
-              sol[j] = 0;
-            }
+            int index = solutionSpecified->index(k);
 
-            // Check integrality constraints
-            for( auto it = solutionSpecified->begin(); it != solutionSpecified->end(); ++it )
+            if( isInt[index] && !isInteger(solutionSpecified->value(k)) )
             {
-               if( isInt[it->first] && !isInteger(it->second) )
-               {
-                  cerr << "Noninteger value for integer variable "
-                       << it->first << endl;
-                  goto TERMINATE;
-               }
-              sol[it->first] = it->second;
+               cerr << "Noninteger value for integer variable "
+                    << index << endl;
+               goto TERMINATE;
             }
+         }
 
-            for( int j = 0; j < numberOfConstraints; ++j )
-            {
-               if( !satisfies(constraint[i], solutionSpecified) )
-               {
-                  cerr << "Constraint " << i << " not satisfied." << endl;
-                  goto TERMINATE;
-               }
-            }
+         cout << "   max violation = " << results[i].maxViolation << " ("
+              << results[i].seconds << " seconds)" << endl;
+
+         if( results[i].violatedRow >= 0 )
+         {
+            cerr << "Constraint " << results[i].violatedRow << " not satisfied." << endl;
+            goto TERMINATE;
          }
 
          value = scalarProduct(objectiveCoefficients , solutionSpecified);
@@ -842,6 +1358,9 @@ bool processDER()
    cout << "numberOfDerivations = " << numberOfDerivations << endl;
 
 
+   if( lastDerivation >= 0 )
+      return checkDerivationRange(firstDerivation, lastDerivation);
+
    // No lower bound to check and no deriviations -> nothing to do
    if( numberOfDerivations == 0 && !checkLower )
    {
@@ -856,224 +1375,179 @@ bool processDER()
       return true;
    }
 
-   string label;
-   int sense;
-   mpq_class rhs;
+   // Exact last uses let the store release every constraint after its last reference
+   vector<int> lastUse;
+   bool useLastUse = false;
 
-   for( int i = 0; i < numberOfDerivations; ++i )
-   {
+   // a stream cannot be read a second time for the pre-scan, a followed file is incomplete
+   bool canPrescan = haveIndex || (!certificateFile.isStream() && followTimeout < 0.0);
 
+   if( prescanMode == PrescanMode::ON && !canPrescan )
+      cout << "Pre-scan skipped, the certificate is " << (followTimeout < 0.0 ? "read from a stream" : "followed") << endl;
+   else if( prescanMode != PrescanMode::OFF && numberOfDerivations > 0 && canPrescan )
+   {
+      auto start = std::chrono::steady_clock::now();
 
-      shared_ptr<SVectorGMP> coef(make_shared<SVectorGMP>());
+      useLastUse = (haveIndex ? indexLastUses(lastUse) : scanLastUses(certificateFile.bytesRead(), lastUse));
 
-      if( !readConstraint(label, sense, rhs, coef) )
+      if( useLastUse )
       {
-         return false;
-      }
+         std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
 
-      // Obtain derivation method and info
-      string bracket, kind;
-      int refIdx;
+         cout << (haveIndex ? "Took" : "Pre-scanned") << " last uses of " << lastUse.size()
+              << " constraints" << (haveIndex ? " from the index" : "") << " in "
+              << duration.count() << " seconds" << endl;
 
-      certificateFile >> bracket >> kind;
+         // constraints of the CON section that are never referenced are released right away
+         int last = constraint.size() - 1;
 
-      if( bracket != "{" )
-      {
-         cerr << "Expecting { but read instead " << bracket << endl;
-         return false;
+         for( int i = 0; i <= last; ++i )
+         {
+            constraint[i].setMaxRefIdx(lastUse[i]);
+            constraint.releaseIfLastUse(i, last);
+         }
       }
+   }
+
+   shared_ptr<CheckPool> pool;
 
-      DerivationType derivationType = DerivationType::UNKNOWN;
+   if( numberOfThreads > 1 )
+   {
+      cout << "Checking derivations on " << numberOfThreads << " threads" << endl;
+      pool = make_shared<CheckPool>(numberOfThreads - 1);
+   }
 
-      if( kind == "asm" )
-         derivationType = DerivationType::ASM;
-      else if( kind == "sol" )
-         derivationType = DerivationType::SOL;
-      else if( kind == "lin" )
-         derivationType = DerivationType::LIN;
-      else if( kind == "rnd" )
-         derivationType = DerivationType::RND;
-      else if( kind == "uns" )
-         derivationType = DerivationType::UNS;
+   // In the pipeline, a tokenizer thread reads the records ahead while they are checked here;
+   // chunked parsing reads them on several threads
+   std::unique_ptr<DerivationQueue> queue;
+   std::unique_ptr<ChunkedReader> chunked;
+   std::thread tokenizer;
+   DerivationRecord record;
+   bool success = true;
+   const char* data = certificateFile.mappedData();
+   size_t offset = certificateFile.bytesRead();
+
+   if( numberOfParseThreads > 1 )
+   {
+      if( data != nullptr && !certificateFile.isBinary() )
+      {
+         cout << "Parsing derivations on " << numberOfParseThreads << " threads" << endl;
+         chunked.reset(new ChunkedReader(data + offset, data + certificateFile.size(), numberOfParseThreads));
+      }
+      else
+         cout << "Chunked parsing needs an uncompressed text certificate, parsing sequentially" << endl;
+   }
 
-      // The constraint to be derived
-      Constraint toDer(label, sense, rhs, coef, (derivationType == DerivationType::ASM), emptyList);
+   if( usePipeline && !chunked )
+   {
+      queue.reset(new DerivationQueue(pipelineCapacity));
+      tokenizer = std::thread(readDerivations, std::ref(*queue));
+   }
 
-#ifndef NDEBUG
-      cout << numberOfConstraints + i << " - deriving..." << label << endl;
-#endif
+   auto lastReport = std::chrono::steady_clock::now();
+   int lastReported = 0;
 
-      SVectorBool assumptionList;
+   // with a pool, an earlier derivation may still fail on a worker, so the messages of a failure
+   // here wait until the pool is finished and are dropped if it reports an earlier one
+   std::ostringstream deferred;
+   std::ostream &errors = (pool ? static_cast<std::ostream&>(deferred) : cerr);
+   int failedIndex = -1;
 
-      int newConIdx = constraint.size();
+   for( int i = 0; i < numberOfDerivations && success; ++i )
+   {
+      if( pool && pool->hasFailed() )
+         break;
 
-      switch( derivationType )
+      // progress while the certificate is written
+      if( followTimeout >= 0.0 && (i & 255) == 0 )
       {
+         auto now = std::chrono::steady_clock::now();
+         std::chrono::duration<double> elapsed = now - lastReport;
 
-      	// Assumption, i.e. set of assumptions only contains index of constraint
-         case DerivationType::ASM:
-            assumptionList[ newConIdx ] = true;
-            certificateFile >> bracket;
-
-            if( bracket != "}" )
-            {
-               cerr << "Expecting } but read instead " << bracket << endl;
-               return false;
-            }
-            break;
-         // Linear combination or rounding
-         case DerivationType::LIN:
-         case DerivationType::RND:
-            {
-               shared_ptr<SVectorGMP> coefDer(make_shared<SVectorGMP>());
-               mpq_class rhsDer;
-               int senseDer;
+         if( elapsed.count() >= progressInterval )
+         {
+            cout << "Checked " << i << " of " << numberOfDerivations << " derivations, "
+                 << (i - lastReported) / elapsed.count() << " derivations/s" << endl;
+            lastReport = now;
+            lastReported = i;
+         }
+      }
 
-              if( !readLinComb(senseDer, rhsDer, coefDer, newConIdx, assumptionList) )
-                 return false;
+      DerivationRecord* current = &record;
 
-               certificateFile >> bracket;
+      if( chunked )
+         current = chunked->next();
+      else if( queue )
+         current = queue->front();
+      else
+         readDerivation(certificateFile, record);
 
-               if( bracket != "}" )
-               {
-                  cerr << "Expecting } but read instead " << bracket << endl;
-                  return false;
-               }
+      if( current == nullptr )
+      {
+         errors << "Derivation " << i << " could not be read" << endl;
+         success = false;
+      }
+      else
+      {
+         success = checkDerivation(*current, i == numberOfDerivations - 1, pool.get(),
+            useLastUse ? &lastUse : nullptr, errors);
 
-               Constraint derived("", senseDer, rhsDer, coefDer, toDer.isAssumption(),
-                                           toDer.getassumptionList());
+         if( queue )
+            queue->pop();
+      }
 
+      if( !success )
+         failedIndex = constraint.size();
+   }
 
-               if( derivationType == DerivationType::RND )   // round the coefficients
-                  if( !derived.round() )
-                     return false;
+   if( chunked )
+   {
+      chunked->stop();
+      certificateFile.skipBytes(chunked->parsedEnd() - (data + offset));
 
+      cout << "Parsed derivations in " << chunked->numberOfChunks() << " chunks, "
+           << chunked->numberOfFallbacks() << " fallbacks to sequential parsing, verifier waited "
+           << chunked->consumerWait() << " seconds" << endl;
+   }
 
-               // check the from reason derived constraint against the given
-               if( !derived.dominates(toDer) )
-               {
-                  cout << "Failed to derive constraint " << label << endl;
-                  toDer.print();
+   if( queue )
+   {
+      queue->stop();
+      tokenizer.join();
 
-                  cout << "Derived instead " << endl;
-                  derived.print();
+      cout << "Pipeline: " << queue->averageOccupancy() << " of " << queue->capacity()
+           << " records queued on average, verifier waited " << queue->consumerWait()
+           << " seconds, tokenizer waited " << queue->producerWait() << " seconds for room and "
+           << certificateFile.readAheadWait() << " seconds for input" << endl;
+   }
 
-                  cout << "difference: " << endl;
-                  (derived - toDer).print();
+   if( followTimeout >= 0.0 )
+      cout << "Waited " << certificateFile.followWait() << " seconds for the certificate to grow" << endl;
 
-                  return false;
-               }
-            }
-            break;
+   if( !success )
+   {
+      if( !pool || pool->finish(failedIndex) )
+         cerr << deferred.str();
+      return false;
+   }
 
-            // Unsplit
-         case DerivationType::UNS:
-            {
-               int con1, asm1, con2, asm2;
+   if( pool && !pool->finish() )
+      return false;
 
-               certificateFile >> con1 >> asm1 >> con2 >> asm2;
+   cout << endl;
 
-               if( certificateFile.fail() )
-               {
-                  cerr << "Error reading con1 asm1 con2 asm2" << endl;
-                  return false;
-               }
+   const AssumptionSet &assumptionList = constraint.back().getassumptionList();
 
-               if( (con1 < 0) || (con1 >= newConIdx) )
-               {
-                  cerr << "con1 out of bounds: " << con1 << endl;
-                  return false;
-               }
 
-               if( (con2 < 0) || (con2 >= newConIdx) )
-               {
-                  cerr << "con2 out of bounds: " << con2 << endl;
-                  return false;
-               }
+   // Final result
+   if( assumptionList != emptyList )
+   {
+      cout << "Final derived constraint undischarged assumptions:" << endl;
+      for( auto it = assumptionList.begin(); it != assumptionList.end(); ++it )
+      {
+         auto index = *it;
 
-               if( !canUnsplit(toDer, con1, asm1, con2, asm2, assumptionList) )
-               {
-                  cerr << label << ": unsplit failed" << endl;
-                  return false;
-               }
-
-               certificateFile >> bracket;
-               if( bracket != "}" )
-               {
-                  cerr << "Expecting } but read instead " << bracket << endl;
-                  return false;
-               }
-            }
-            break;
-         case DerivationType::SOL:
-         {
-            mpq_class cutoffbound = bestObjectiveValue;
-            if (objectiveIntegral)
-            {
-               cutoffbound -= 1;
-            }
-            certificateFile >> bracket;
-            if (coef != objectiveCoefficients)
-            {
-               cerr << "Cutoff bound can only be applied to objective value " << endl;
-               return false;
-            }
-            else if (sense != -1)
-            {
-               cerr << "Cutoff bound should have sense 'L'" << endl;
-               return false;
-            }
-            else if (rhs < cutoffbound )
-            {
-               cerr << "No solution known with objective at most " << rhs << ", best solution is " << bestObjectiveValue << endl;
-               return false;
-            }
-            else if( bracket != "}" )
-            {
-               cerr << "Expecting } but read instead " << bracket << endl;
-               return false;
-            }
-            break;
-         }
-         default:
-            cout << label << ": unknown derivation type " << kind << endl;
-            return false;
-            break;
-      }
-
-      // Set the list of assumptions
-      toDer.setassumptionList(assumptionList);
-
-      // Constraint hierarchy handling (??)
-      certificateFile >> refIdx;
-      toDer.setMaxRefIdx(refIdx);
-      constraint.push_back(toDer);
-
-      if( i < numberOfDerivations - 1 ) // Never trash last constraint
-         if( (refIdx >= 0) && (refIdx < int(constraint.size())) )
-         {
-             constraint.back().trash();
-         }
-
-#ifndef NDEBUG
-      toDer.print();
-#endif
-   }
-
-   cout << endl;
-
-   auto assumptionList = constraint.back().getassumptionList();
-
-
-   // Final result
-   if( assumptionList != emptyList )
-   {
-      cout << "Final derived constraint undischarged assumptions:" << endl;
-      for( auto it = assumptionList.begin(); it != assumptionList.end(); ++it )
-      {
-         auto index = it->first;
-
-         cout << index << ": " << constraint[index].label() << endl;
+         cout << index << ": " << constraint.label(index) << endl;
       }
    }
    else
@@ -1128,424 +1602,2140 @@ bool processDER()
 
 
 
-// Classes and Functions
-inline mpq_class floor(const mpq_class &q)
+// Reads the next derivation into record without resolving its references.  Returns false if
+// reading cannot continue after this record; checkDerivation then reports the error
+bool readDerivation( CertificateInput &in, DerivationRecord &record )
 {
-   mpz_t z;
-   mpq_class result;
-   mpz_init (z);
-   mpz_fdiv_q(z, q.get_num_mpz_t(), q.get_den_mpz_t()); // Divide numerator by denominator and floor the result
-   result = mpz_class(z);
-   mpz_clear (z);
-   return result;
+   record.constraintRead = false;
+   record.referencesRead = false;
+   record.type = DerivationType::UNKNOWN;
+   record.numberOfMultipliers = 0;
+   record.bracket.clear();
+   record.closing.clear();
+   if( record.errors.tellp() > 0 )
+      record.errors.str("");
+
+   record.coefficients = make_shared<SVectorGMP>();
+
+   if( !readConstraint(in, record.label, record.sense, record.rhs, record.coefficients, record.errors) )
+      return false;
+
+   record.constraintRead = true;
+
+   // Obtain derivation method and info
+   in >> record.bracket >> record.kind;
+
+   if( record.bracket != "{" )
+      return false;
+
+   if( record.kind == "asm" )
+      record.type = DerivationType::ASM;
+   else if( record.kind == "sol" )
+      record.type = DerivationType::SOL;
+   else if( record.kind == "lin" )
+      record.type = DerivationType::LIN;
+   else if( record.kind == "rnd" )
+      record.type = DerivationType::RND;
+   else if( record.kind == "uns" )
+      record.type = DerivationType::UNS;
+
+   switch( record.type )
+   {
+      case DerivationType::ASM:
+      case DerivationType::SOL:
+         break;
+      case DerivationType::LIN:
+      case DerivationType::RND:
+         {
+            int k = 0;
+            size_t n = 0;
+
+            in >> k;
+
+            // An unreadable count leaves the stream failed; as when the record was read in
+            // place, this is reported as a missing closing bracket
+            if( in.fail() )
+            {
+               record.numberOfMultipliers = 0;
+               record.referencesRead = true;
+               record.closing = record.bracket;
+               return false;
+            }
+
+            for( int j = 0; j < k; ++j, ++n )
+            {
+               if( n == record.indices.size() )
+               {
+                  record.indices.resize(2 * n + 16);
+                  record.multipliers.resize(2 * n + 16);
+               }
+
+               in >> record.indices[n] >> record.multipliers[n];
+
+               if( in.fail() )
+               {
+                  record.numberOfMultipliers = n;
+                  return false;
+               }
+            }
+
+            record.numberOfMultipliers = n;
+         }
+         break;
+      case DerivationType::UNS:
+         in >> record.unsplit[0] >> record.unsplit[1] >> record.unsplit[2]
+                         >> record.unsplit[3];
+
+         if( in.fail() )
+            return false;
+         break;
+      default:
+         return false;
+   }
+
+   record.referencesRead = true;
+   in >> record.closing;
+
+   if( record.closing != "}" )
+      return false;
+
+   // Constraint hierarchy handling (??)
+   in >> record.refIdx;
+
+   return true;
+}
+
+
+// Tokenizer thread of the pipeline: reads all derivations into the queue
+void readDerivations( DerivationQueue &queue )
+{
+   for( int i = 0; i < numberOfDerivations; ++i )
+   {
+      DerivationRecord* record = queue.slot();
+
+      if( record == nullptr )
+         break;
+
+      bool more = readDerivation(certificateFile, *record);
+
+      queue.push();
+
+      if( !more )
+         break;
+   }
+
+   queue.close();
+}
+
+
+// Checks a derivation read by readDerivation and adds the derived constraint to the store.
+// The last use of the new constraint is taken from lastUse if given, otherwise from the record
+bool checkDerivation( DerivationRecord &record, bool isLast, CheckPool* pool,
+                      const vector<int>* lastUse, std::ostream &errors )
+{
+   if( !record.constraintRead )
+   {
+      errors << record.errors.str();
+      return false;
+   }
+
+   record.coefficients = rowTable.intern(record.coefficients);
+
+   if( record.bracket != "{" )
+   {
+      errors << "Expecting { but read instead " << record.bracket << endl;
+      return false;
+   }
+
+   // The constraint to be derived
+   Constraint toDer(record.label, record.sense, record.rhs, record.coefficients,
+      (record.type == DerivationType::ASM), emptyList);
+
+#ifndef NDEBUG
+   cout << constraint.size() << " - deriving..." << record.label << endl;
+#endif
+
+   AssumptionSet assumptionList;
+
+   int newConIdx = constraint.size();
+
+   switch( record.type )
+   {
+
+      // Assumption, i.e. set of assumptions only contains index of constraint
+      case DerivationType::ASM:
+         assumptionList = AssumptionSet::singleton(newConIdx);
+
+         if( record.closing != "}" )
+         {
+            errors << "Expecting } but read instead " << record.closing << endl;
+            return false;
+         }
+         break;
+      // Linear combination or rounding
+      case DerivationType::LIN:
+      case DerivationType::RND:
+         {
+            shared_ptr<LinCombCheck> check(make_shared<LinCombCheck>());
+
+            check->index = newConIdx;
+            check->type = record.type;
+
+            if( !resolveLinComb(record, *check, newConIdx, assumptionList, errors) )
+               return false;
+
+            if( record.closing != "}" )
+            {
+               errors << "Expecting } but read instead " << record.closing << endl;
+               return false;
+            }
+
+            check->label = record.label;
+            check->statedSense = record.sense;
+            check->statedRhs = record.rhs;
+            check->statedCoefficients = record.coefficients;
+
+            // the arithmetic is checked by the pool, assumptions are handled here in order
+            if( pool )
+            {
+               pool->submit(check);
+            }
+            else
+            {
+               shared_ptr<Constraint> derived;
+
+               if( !checkLinComb(*check, derived) )
+               {
+                  errors << check->errors;
+                  if( derived )
+                     printFailedLinComb(*check, *derived);
+                  return false;
+               }
+            }
+         }
+         break;
+
+         // Unsplit
+      case DerivationType::UNS:
+         {
+            if( !record.referencesRead )
+            {
+               errors << "Error reading con1 asm1 con2 asm2" << endl;
+               return false;
+            }
+
+            int con1 = record.unsplit[0];
+            int asm1 = record.unsplit[1];
+            int con2 = record.unsplit[2];
+            int asm2 = record.unsplit[3];
+
+            if( (con1 < 0) || (con1 >= newConIdx) )
+            {
+               errors << "con1 out of bounds: " << con1 << endl;
+               return false;
+            }
+
+            if( (con2 < 0) || (con2 >= newConIdx) )
+            {
+               errors << "con2 out of bounds: " << con2 << endl;
+               return false;
+            }
+
+            if( !canUnsplit(toDer, con1, asm1, con2, asm2, assumptionList, errors) )
+            {
+               errors << record.label << ": unsplit failed" << endl;
+               return false;
+            }
+
+            constraint.releaseIfLastUse(con1, newConIdx);
+            constraint.releaseIfLastUse(asm1, newConIdx);
+            constraint.releaseIfLastUse(con2, newConIdx);
+            constraint.releaseIfLastUse(asm2, newConIdx);
+
+            if( record.closing != "}" )
+            {
+               errors << "Expecting } but read instead " << record.closing << endl;
+               return false;
+            }
+         }
+         break;
+      case DerivationType::SOL:
+      {
+         Rational cutoffbound = bestObjectiveValue;
+         if (objectiveIntegral)
+         {
+            cutoffbound -= 1;
+         }
+         if (record.coefficients != objectiveCoefficients)
+         {
+            errors << "Cutoff bound can only be applied to objective value " << endl;
+            return false;
+         }
+         else if (record.sense != -1)
+         {
+            errors << "Cutoff bound should have sense 'L'" << endl;
+            return false;
+         }
+         else if (record.rhs < cutoffbound )
+         {
+            errors << "No solution known with objective at most " << record.rhs << ", best solution is " << bestObjectiveValue << endl;
+            return false;
+         }
+         else if( record.closing != "}" )
+         {
+            errors << "Expecting } but read instead " << record.closing << endl;
+            return false;
+         }
+         break;
+      }
+      default:
+         cout << record.label << ": unknown derivation type " << record.kind << endl;
+         return false;
+         break;
+   }
+
+   // Set the list of assumptions
+   toDer.setassumptionList(assumptionList);
+
+   toDer.setMaxRefIdx(lastUse != nullptr ? (*lastUse)[newConIdx] : record.refIdx);
+   constraint.add(toDer);
+
+   if( !isLast ) // Never release last constraint
+      constraint.releaseIfLastUse(newConIdx, newConIdx);
+
+#ifndef NDEBUG
+   toDer.print();
+#endif
+
+   return true;
+}
+
+
+// Computes the index of the last derivation referencing each constraint by reading only the
+// indices of the DER section, which starts at the given offset of the certificate; rationals
+// are skipped without conversion.  Constraints that are never referenced get their own index.
+// Returns false if the certificate has last-use indices in auto mode or if the scan fails, in
+// which case the check itself reports the error
+bool scanLastUses( size_t offset, vector<int> &lastUse )
+{
+   CertificateInput scan;
+   Token token;
+   int first = constraint.size();
+
+   if( !scan.open(certificateFileName) || scan.bytesRead() > offset
+      || !scan.skipBytes(offset - scan.bytesRead()) )
+      return false;
+
+   lastUse.assign(first + numberOfDerivations, -1);
+
+   for( int i = 0; i < numberOfDerivations; ++i )
+   {
+      int current = first + i;
+      long k = 0;
+      int index = -1, refIdx = -1;
+
+      auto use = [&](int index) {
+         if( index >= 0 && index < current )
+            lastUse[index] = current;
+      };
+
+      // label, sense, rhs and coefficients
+      scan.skip();
+      scan.skip();
+      scan.skip();
+      scan.next(token);
+
+      if( token != "OBJ" )
+      {
+         if( !CertificateInput::toLong(token, k) || k < 0 )
+            return false;
+
+         for( long j = 0; j < 2 * k; ++j )
+            scan.skip();
+      }
+
+      if( !scan.next(token) || token != "{" || !scan.next(token) )
+         return false;
+
+      if( token == "lin" || token == "rnd" )
+      {
+         scan >> k;
+         for( long j = 0; j < k && !scan.fail(); ++j )
+         {
+            scan >> index;
+            if( scan.fail() )
+               return false;
+            scan.skipNumber();
+            use(index);
+         }
+      }
+      else if( token == "uns" )
+      {
+         for( int j = 0; j < 4; ++j )
+         {
+            scan >> index;
+            if( scan.fail() )
+               return false;
+            use(index);
+         }
+      }
+
+      if( !scan.next(token) || token != "}" )
+         return false;
+
+      scan >> refIdx;
+
+      if( scan.fail() )
+         return false;
+
+      if( i == 0 && prescanMode == PrescanMode::AUTO && refIdx >= 0 )
+         return false;
+   }
+
+   for( int i = 0; i < int(lastUse.size()); ++i )
+   {
+      if( lastUse[i] < 0 )
+         lastUse[i] = i;
+   }
+
+   return true;
+}
+
+
+// Computes the last uses like scanLastUses, but from the references stored in the index
+bool indexLastUses( vector<int> &lastUse )
+{
+   int first = constraint.size();
+
+   if( certificateIndex.numberOfConstraints() != first
+      || certificateIndex.numberOfDerivations() != numberOfDerivations )
+      return false;
+
+   lastUse.assign(first + numberOfDerivations, -1);
+
+   for( int i = 0; i < numberOfDerivations; ++i )
+   {
+      size_t count;
+      const int* refs = certificateIndex.references(i, count);
+
+      for( size_t j = 0; j < count; ++j )
+      {
+         if( refs[j] >= 0 && refs[j] < first + i )
+            lastUse[refs[j]] = first + i;
+      }
+   }
+
+   for( int i = 0; i < int(lastUse.size()); ++i )
+   {
+      if( lastUse[i] < 0 )
+         lastUse[i] = i;
+   }
+
+   return true;
+}
+
+
+// Checks only the derivations first to last, which are located through the index.  The earlier
+// derivations referenced by them are read and taken as given, with their assumptions unknown,
+// so the check is local: the final claim and the discharge of assumptions are not verified
+bool checkDerivationRange( int first, int last )
+{
+   int numCon = constraint.size();
+
+   if( certificateIndex.numberOfConstraints() != numCon
+      || certificateIndex.numberOfDerivations() != numberOfDerivations )
+   {
+      cerr << "Index does not match the certificate" << endl;
+      return false;
+   }
+
+   last = std::min(last, numberOfDerivations - 1);
+
+   if( first > last )
+   {
+      cerr << "No derivation in range " << first << ":" << last << endl;
+      return false;
+   }
+
+   vector<int> given;
+
+   for( int i = first; i <= last; ++i )
+   {
+      size_t count;
+      const int* refs = certificateIndex.references(i, count);
+
+      for( size_t j = 0; j < count; ++j )
+      {
+         if( refs[j] >= numCon && refs[j] < numCon + first )
+            given.push_back(refs[j]);
+      }
+   }
+
+   std::sort(given.begin(), given.end());
+   given.erase(std::unique(given.begin(), given.end()), given.end());
+
+   DerivationRecord record;
+
+   for( int index : given )
+   {
+      if( !certificateFile.seek(certificateIndex.offset(index - numCon))
+         || !readDerivation(certificateFile, record) )
+      {
+         cerr << "Derivation " << index - numCon << " could not be read" << endl;
+         return false;
+      }
+
+      bool isAsm = (record.type == DerivationType::ASM);
+      Constraint con(record.label, record.sense, record.rhs, rowTable.intern(record.coefficients),
+         isAsm, isAsm ? AssumptionSet::singleton(index) : emptyList);
+
+      con.setMaxRefIdx(record.refIdx);
+      constraint.skipTo(index);
+      constraint.add(con);
+   }
+
+   constraint.skipTo(numCon + first);
+
+   cout << "Checking derivations " << first << " to " << last << ", taking " << given.size()
+        << " earlier derivations as given" << endl;
+
+   shared_ptr<CheckPool> pool;
+   bool success = certificateFile.seek(certificateIndex.offset(first));
+
+   if( numberOfThreads > 1 )
+      pool = make_shared<CheckPool>(numberOfThreads - 1);
+
+   // messages of a failure here are dropped if the pool reports an earlier one, as in processDER
+   std::ostringstream deferred;
+   std::ostream &errors = (pool ? static_cast<std::ostream&>(deferred) : cerr);
+   int failedIndex = std::numeric_limits<int>::max();
+
+   for( int i = first; i <= last && success; ++i )
+   {
+      if( pool && pool->hasFailed() )
+         break;
+
+      readDerivation(certificateFile, record);
+      success = checkDerivation(record, i == numberOfDerivations - 1, pool.get(), nullptr, errors);
+
+      if( !success )
+         failedIndex = constraint.size();
+   }
+
+   if( pool && !pool->finish(failedIndex) )
+      success = false;
+   else if( !success )
+      cerr << deferred.str();
+
+   if( success )
+   {
+      cout << "Successfully checked derivations " << first << " to " << last << endl;
+      cout << "The final claim and the assumptions are only verified by checking all derivations" << endl;
+   }
+
+   return success;
+}
+
+
+// Classes and Functions
+// maximum resident set size of the process so far, -1 if unknown
+double peakResidentMegabytes()
+{
+#ifdef VIPR_HAVE_RUSAGE
+   struct rusage usage;
+
+   if( getrusage(RUSAGE_SELF, &usage) == 0 )
+#ifdef __APPLE__
+      return usage.ru_maxrss / 1e6; // bytes
+#else
+      return usage.ru_maxrss / 1e3; // kilobytes
+#endif
+#endif
+   return -1;
+}
+
+
+inline mpq_class floor(const mpq_class &q)
+{
+   mpz_t z;
+   mpq_class result;
+   mpz_init (z);
+   mpz_fdiv_q(z, q.get_num_mpz_t(), q.get_den_mpz_t()); // Divide numerator by denominator and floor the result
+   result = mpz_class(z);
+   mpz_clear (z);
+   return result;
+}
+
+
+inline mpq_class ceil(const mpq_class &q)
+{
+   mpz_t z;
+   mpq_class result;
+   mpz_init (z);
+   mpz_cdiv_q(z, q.get_num_mpz_t(), q.get_den_mpz_t()); // Divide numerator by denominator and ceil the result
+   result = mpz_class(z);
+   mpz_clear (z);
+   return result;
+}
+
+bool isInteger(const mpq_class &q)
+{
+   return (q == floor(q));
+}
+
+
+// Reads the multipliers of a lin/rnd derivation and collects the referenced rows for the
+// arithmetic check.  The assumptions of the referenced constraints are merged into
+// assumptionList and constraints used for the last time are released
+bool resolveLinComb( const DerivationRecord &record, LinCombCheck &check, int currentConstraintIndex,
+                     AssumptionSet &assumptionList, std::ostream &errors)
+{
+   bool returnStatement = true;
+
+   SVectorGMP mult;
+
+   if( !resolveMultipliers(record, check.sense, mult, errors) )
+   {
+      returnStatement = false;
+   }
+   else
+   {
+      check.terms.clear();
+      check.terms.reserve(mult.size());
+      assumptionList = emptyList;
+
+      for( size_t k = 0; k < mult.size(); ++k )
+      {
+         auto index = mult.index(k);
+         Constraint* con = constraint.find(index);
+
+         if( con == nullptr )
+         {
+            errors << "Accessing released constraint: " << constraint.label(index) << endl;
+            returnStatement = false;
+         }
+         else
+         {
+            LinCombTerm term;
+
+            assumptionList = assumptionList.unite(con->getassumptionList());
+
+            term.multiplier = mult.value(k);
+            term.coefficients = con->coefSVec();
+            term.rhs = con->getRhs();
+            check.terms.push_back(term);
+
+            constraint.releaseIfLastUse(index, currentConstraintIndex);
+         }
+      }
+   }
+
+   return returnStatement;
+}
+
+
+// Passes values to the common denominator kernel, small ones without converting them to GMP
+inline void setMultiplier( CommonDenominatorAccumulator &sum, const mpq_class &q )
+{
+   sum.setMultiplier(q.get_num_mpz_t(), q.get_den_mpz_t());
+}
+
+inline void addProduct( CommonDenominatorAccumulator &sum, int index, const mpq_class &q )
+{
+   sum.addFraction(index, q.get_num_mpz_t(), q.get_den_mpz_t());
+}
+
+inline bool entryEquals( CommonDenominatorAccumulator &sum, int index, const mpq_class &q )
+{
+   return sum.equals(index, q.get_num_mpz_t(), q.get_den_mpz_t());
+}
+
+#ifdef VIPR_HAVE_HYBRID_RATIONAL
+inline void setMultiplier( CommonDenominatorAccumulator &sum, const HybridRational &q )
+{
+   if( q.isSmall() && sizeof(long) >= sizeof(int64_t) )
+      sum.setMultiplier(long(q.num()), (unsigned long)q.den());
+   else
+      setMultiplier(sum, q.isSmall() ? q.get_mpq() : q.bigValue());
+}
+
+inline void addProduct( CommonDenominatorAccumulator &sum, int index, const HybridRational &q )
+{
+   if( q.isSmall() && sizeof(long) >= sizeof(int64_t) )
+      sum.addFraction(index, long(q.num()), (unsigned long)q.den());
+   else
+      addProduct(sum, index, q.isSmall() ? q.get_mpq() : q.bigValue());
+}
+
+inline bool entryEquals( CommonDenominatorAccumulator &sum, int index, const HybridRational &q )
+{
+   if( q.isSmall() && sizeof(long) >= sizeof(int64_t) )
+      return sum.equals(index, long(q.num()), (unsigned long)q.den());
+   else
+      return entryEquals(sum, index, q.isSmall() ? q.get_mpq() : q.bigValue());
+}
+#endif
+
+inline bool entryIsZero( CommonDenominatorAccumulator &sum, int index )
+{
+   return sum.isZero(index);
+}
+
+inline bool entryIsInteger( CommonDenominatorAccumulator &sum, int index )
+{
+   return sum.isInteger(index);
+}
+
+inline Rational entryValue( CommonDenominatorAccumulator &sum, int index )
+{
+   static thread_local mpq_class value;
+
+   sum.get(index, value.get_mpq_t());
+   return Rational(value);
+}
+
+
+// The same for the rational kernel
+inline bool entryEquals( DenseAccumulator<Rational> &sum, int index, const Rational &q )
+{
+   return sum[index] == q;
+}
+
+inline bool entryIsZero( DenseAccumulator<Rational> &sum, int index )
+{
+   return sum[index] == 0;
+}
+
+inline bool entryIsInteger( DenseAccumulator<Rational> &sum, int index )
+{
+   return isInteger(sum[index]);
+}
+
+inline Rational entryValue( DenseAccumulator<Rational> &sum, int index )
+{
+   return sum[index];
+}
+
+
+// Sums up the linear combination with the common denominator kernel, the rhs as entry -1
+void sumCommonDenominator( const LinCombCheck &check, CommonDenominatorAccumulator &combination )
+{
+   for( auto it = check.terms.begin(); it != check.terms.end(); ++it )
+   {
+      const SVectorGMP &c = *it->coefficients;
+
+      setMultiplier(combination, it->multiplier);
+
+      for( size_t k = 0; k < c.size(); ++k )
+         addProduct(combination, c.index(k), c.value(k));
+
+      addProduct(combination, -1, it->rhs);
+   }
+}
+
+
+// Sums up the linear combination with one rational per variable
+void sumRational( const LinCombCheck &check, DenseAccumulator<Rational> &combination, Rational &rhsDer )
+{
+   for( auto it = check.terms.begin(); it != check.terms.end(); ++it )
+   {
+      const Rational &a = it->multiplier;
+      const SVectorGMP &c = *it->coefficients;
+
+      for( size_t k = 0; k < c.size(); ++k )
+         combination.addProduct(c.index(k), a, c.value(k));
+
+      rhsDer += a * it->rhs;
+   }
+}
+
+
+// Compares the summed up linear combination with the stated constraint while reading it from
+// the accumulator, in one merge of the sorted touched indices with the stated row that stops
+// at the first difference.  Neither a derived row nor a constraint is built unless the check
+// fails, in which case the derived constraint is materialized, rounded and compared as before
+// and returned in failed for reporting
+template <class Accumulator>
+bool compareLinComb( Accumulator &combination, Rational &rhsDer, LinCombCheck &check,
+   shared_ptr<Constraint> &failed )
+{
+   const SVectorGMP &stated = *check.statedCoefficients;
+   bool rounding = (check.type == DerivationType::RND);
+   bool isZero = true;
+   bool differs = false;
+   size_t l = 0;
+
+   combination.sortTouched();
+
+   for( size_t k = 0; k < combination.numberOfTouched() && !differs; ++k )
+   {
+      int index = combination.touched(k);
+
+      if( entryIsZero(combination, index) )
+         continue;
+
+      // a nonzero coefficient rules out 0 >= 1, so only the same row can dominate
+      isZero = false;
+      differs = l == stated.size() || stated.index(l) != index
+         || !entryEquals(combination, index, stated.value(l))
+         || (rounding && isInt[index] && !entryIsInteger(combination, index));
+      ++l;
+   }
+
+   if( !differs )
+   {
+      if( rounding && check.sense < 0 )
+         rhsDer = floor(rhsDer);
+      else if( rounding && check.sense > 0 )
+         rhsDer = ceil(rhsDer);
+
+      if( isZero && Constraint::isContradiction(check.sense, rhsDer) )
+         return true;
+      if( l == stated.size() && Constraint::impliesRhs(check.sense, rhsDer, check.statedSense, check.statedRhs) )
+         return true;
+   }
+
+   shared_ptr<SVectorGMP> coefDer(make_shared<SVectorGMP>());
+
+   coefDer->reserve(combination.numberOfTouched());
+   for( size_t k = 0; k < combination.numberOfTouched(); ++k )
+   {
+      int index = combination.touched(k);
+
+      if( !entryIsZero(combination, index) )
+         coefDer->append(index, entryValue(combination, index));
+   }
+
+   shared_ptr<Constraint> derived(make_shared<Constraint>("", check.sense, rhsDer, coefDer, false, emptyList));
+
+   // rounding again does not change a rounded rhs; round() reports fractional coefficients,
+   // which are kept with the check since this may run on a worker
+   std::ostringstream errors;
+
+   if( !rounding || derived->round(errors) )
+      failed = derived;
+   else
+      check.errors = errors.str();
+
+   return false;
+}
+
+
+// Computes the linear combination of a lin/rnd derivation, rounds it in case of rnd and checks
+// that the result dominates the stated constraint.  Only touches data owned by check.
+// If the domination fails, the derived constraint is returned in failed
+bool checkLinComb( LinCombCheck &check, shared_ptr<Constraint> &failed )
+{
+   // one accumulator of each kind per thread, reused for all derivations checked by it
+   static thread_local DenseAccumulator<Rational> rationalSums;
+   static thread_local CommonDenominatorAccumulator commonSums;
+   Rational rhsDer = 0;
+   bool success;
+
+   if( linCombKernel == LinCombKernel::COMMON_DENOMINATOR )
+   {
+      if( commonSums.dimension() != size_t(numberOfVariables) )
+         commonSums.resize(numberOfVariables);
+
+      sumCommonDenominator(check, commonSums);
+      rhsDer = entryValue(commonSums, -1);
+      success = compareLinComb(commonSums, rhsDer, check, failed);
+      commonSums.clear();
+   }
+   else
+   {
+      if( rationalSums.dimension() != size_t(numberOfVariables) )
+         rationalSums.resize(numberOfVariables);
+
+      sumRational(check, rationalSums, rhsDer);
+      success = compareLinComb(rationalSums, rhsDer, check, failed);
+      rationalSums.clear();
+   }
+
+   return success;
+}
+
+
+void printFailedLinComb( LinCombCheck &check, Constraint &derived )
+{
+   Constraint stated(check.label, check.statedSense, check.statedRhs, check.statedCoefficients,
+      false, emptyList);
+
+   cout << "Failed to derive constraint " << check.label << endl;
+   stated.print();
+
+   cout << "Derived instead " << endl;
+   derived.print();
+
+   cout << "difference: " << endl;
+   (derived - stated).print();
+}
+
+
+// ConstraintStore methods
+int ConstraintStore::add(const Constraint &con)
+{
+   _live.emplace(_size, con);
+   _peakLive = std::max(_peakLive, _live.size());
+
+   return _size++;
+}
+
+
+Constraint* ConstraintStore::find(int index)
+{
+   auto it = _live.find(index);
+
+   return it != _live.end() ? &it->second : nullptr;
+}
+
+
+string ConstraintStore::label(int index) const
+{
+   auto it = _live.find(index);
+
+   if( it != _live.end() )
+      return it->second.label();
+
+   auto released = _releasedAssumptions.find(index);
+
+   if( released != _releasedAssumptions.end() )
+      return released->second;
+
+   return "index " + std::to_string(index) + (index >= 0 && index < _size ? " (released)" : "");
+}
+
+
+void ConstraintStore::release(int index)
+{
+   auto it = _live.find(index);
+
+   if( it == _live.end() )
+      return;
+
+   if( it->second.isAssumption() )
+      _releasedAssumptions.emplace(index, it->second.label());
+
+   _live.erase(it);
+}
+
+
+void ConstraintStore::releaseIfLastUse(int index, int current)
+{
+   auto it = _live.find(index);
+
+   if( it != _live.end() && it->second.getMaxRefIdx() >= 0 && it->second.getMaxRefIdx() <= current )
+      release(index);
+}
+
+
+// DerivationQueue methods
+void DerivationQueue::_backoff(int &round)
+{
+   if( ++round < 64 )
+      std::this_thread::yield();
+   else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+
+DerivationRecord* DerivationQueue::slot()
+{
+   size_t head = _head.load(std::memory_order_relaxed);
+
+   if( head - _tail.load(std::memory_order_acquire) == _ring.size() )
+   {
+      auto start = std::chrono::steady_clock::now();
+      int round = 0;
+
+      while( head - _tail.load(std::memory_order_acquire) == _ring.size()
+         && !_stopped.load(std::memory_order_acquire) )
+         _backoff(round);
+
+      std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+      _producerWait += waited.count();
+   }
+
+   if( _stopped.load(std::memory_order_acquire) )
+      return nullptr;
+
+   return &_ring[head % _ring.size()];
+}
+
+
+void DerivationQueue::push()
+{
+   _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+void DerivationQueue::close()
+{
+   _closed.store(true, std::memory_order_release);
+}
+
+
+DerivationRecord* DerivationQueue::front()
+{
+   size_t tail = _tail.load(std::memory_order_relaxed);
+   size_t head = _head.load(std::memory_order_acquire);
+
+   if( head == tail )
+   {
+      auto start = std::chrono::steady_clock::now();
+      int round = 0;
+
+      // records pushed before closing are visible once the queue is seen closed
+      while( (head = _head.load(std::memory_order_acquire)) == tail
+         && !(_closed.load(std::memory_order_acquire) && _head.load(std::memory_order_acquire) == tail) )
+         _backoff(round);
+
+      head = _head.load(std::memory_order_acquire);
+
+      std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+      _consumerWait += waited.count();
+
+      if( head == tail )
+         return nullptr;
+   }
+
+   _occupancy += head - tail;
+   ++_pops;
+
+   return &_ring[tail % _ring.size()];
+}
+
+
+void DerivationQueue::pop()
+{
+   _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+void DerivationQueue::stop()
+{
+   _stopped.store(true, std::memory_order_release);
+}
+
+
+// ChunkedReader methods
+ChunkedReader::ChunkedReader(const char* begin, const char* end, int numberOfThreads)
+   : _begin(begin), _end(end), _numberOfThreads(numberOfThreads), _parsedEnd(begin)
+{
+   _producer = std::thread(&ChunkedReader::_run, this);
+}
+
+
+void ChunkedReader::stop()
+{
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stopRequested = true;
+   }
+   _changed.notify_all();
+
+   if( _producer.joinable() )
+      _producer.join();
+}
+
+
+const char* ChunkedReader::_skipSpace(const char* p) const
+{
+   while( p < _end && (unsigned char)*p <= ' ' )
+      ++p;
+
+   return p;
+}
+
+
+// Returns the start of the token following the first "} <index>" at or after p, or the end
+const char* ChunkedReader::_findBoundary(const char* p) const
+{
+   for( ; p < _end; ++p )
+   {
+      p = static_cast<const char*>(memchr(p, '}', _end - p));
+
+      if( p == nullptr )
+         return _end;
+
+      const char* q = p + 1;
+
+      // the bracket may directly follow the last multiplier
+      if( (p > _begin && (unsigned char)p[-1] > ' ' && (unsigned)(p[-1] - '0') > 9)
+         || q == _end || (unsigned char)*q > ' ' )
+         continue;
+
+      q = _skipSpace(q);
+      if( q < _end && *q == '-' )
+         ++q;
+
+      const char* digits = q;
+
+      while( q < _end && (unsigned)(*q - '0') <= 9 )
+         ++q;
+
+      if( q > digits && (q == _end || (unsigned char)*q <= ' ') )
+         return _skipSpace(q);
+   }
+
+   return _end;
+}
+
+
+// Parses the derivations that start before stop; returns the position after the last one.
+// Parsing ends after a record that could not be read completely
+const char* ChunkedReader::_parseChunk(const char* start, const char* stop, Chunk &chunk,
+   bool &failed) const
+{
+   CertificateInput in;
+   const char* base = _skipSpace(start);
+   const char* p = base;
+
+   in.openMemory(base, _end - base);
+   failed = false;
+
+   while( p < stop && !failed )
+   {
+      chunk.emplace_back();
+      failed = !readDerivation(in, chunk.back());
+      p = _skipSpace(base + in.bytesRead());
+   }
+
+   return p;
+}
+
+
+// Producer thread
+void ChunkedReader::_run()
+{
+   const char* position = _skipSpace(_begin);
+   long parsed = 0;
+   bool failed = false;
+
+   while( position < _end && parsed < numberOfDerivations && !failed )
+   {
+      const char* windowEnd = position + std::min(size_t(_end - position), size_t(_windowSize));
+      size_t length = windowEnd - position;
+      vector<const char*> starts(1, position);
+
+      for( int j = 1; j < _numberOfThreads; ++j )
+      {
+         const char* boundary = _findBoundary(position + j * length / _numberOfThreads);
+
+         if( boundary < windowEnd && boundary > starts.back() )
+            starts.push_back(boundary);
+      }
+
+      size_t n = starts.size();
+      Window window(n);
+      vector<const char*> ends(n);
+      vector<char> chunkFailed(n);
+      vector<std::thread> threads;
+
+      auto parse = [&](size_t j) {
+         bool f;
+
+         window[j] = make_shared<Chunk>();
+         ends[j] = _parseChunk(starts[j], j + 1 < n ? starts[j + 1] : windowEnd, *window[j], f);
+         chunkFailed[j] = f;
+      };
+
+      for( size_t j = 1; j < n; ++j )
+         threads.emplace_back(parse, j);
+      parse(0);
+      for( auto &thread : threads )
+         thread.join();
+
+      // a chunk is used if the chunk before ended exactly at its start
+      size_t accepted = 1;
+
+      while( accepted < n && !chunkFailed[accepted - 1] && ends[accepted - 1] == starts[accepted] )
+         ++accepted;
+
+      if( accepted < n && !chunkFailed[accepted - 1] )
+      {
+         bool f;
+
+         window[accepted] = make_shared<Chunk>();
+         ends[accepted] = _parseChunk(ends[accepted - 1], windowEnd, *window[accepted], f);
+         chunkFailed[accepted] = f;
+         ++accepted;
+         ++_numberOfFallbacks;
+      }
+
+      window.resize(accepted);
+      failed = chunkFailed[accepted - 1];
+      position = ends[accepted - 1];
+      _numberOfChunks += accepted;
+
+      for( auto &chunk : window )
+         parsed += chunk->size();
+
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      _changed.wait(lock, [this]() { return _queue.size() < _queueSize || _stopRequested; });
+
+      if( _stopRequested )
+         break;
+
+      _queue.push_back(std::move(window));
+      _parsedEnd = position;
+      lock.unlock();
+      _changed.notify_all();
+   }
+
+   std::lock_guard<std::mutex> lock(_mutex);
+   _done = true;
+   _changed.notify_all();
+}
+
+
+DerivationRecord* ChunkedReader::next()
+{
+   while( _chunkIndex >= _current.size() || _recordIndex >= _current[_chunkIndex]->size() )
+   {
+      if( _chunkIndex < _current.size() )
+      {
+         ++_chunkIndex;
+         _recordIndex = 0;
+         continue;
+      }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+
+      if( _queue.empty() && !_done )
+      {
+         auto start = std::chrono::steady_clock::now();
+
+         _changed.wait(lock, [this]() { return !_queue.empty() || _done; });
+
+         std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+         _consumerWait += waited.count();
+      }
+
+      if( _queue.empty() )
+         return nullptr;
+
+      _current = std::move(_queue.front());
+      _queue.pop_front();
+      _chunkIndex = 0;
+      _recordIndex = 0;
+      lock.unlock();
+      _changed.notify_all();
+   }
+
+   return &(*_current[_chunkIndex])[_recordIndex++];
+}
+
+
+// CheckPool methods
+CheckPool::CheckPool(int numberOfWorkers) : _capacity(64 * numberOfWorkers), _failed(false)
+{
+   for( int i = 0; i < numberOfWorkers; ++i )
+      _workers.push_back(std::thread(&CheckPool::_work, this));
+}
+
+
+CheckPool::~CheckPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+      _queue.clear();
+   }
+   _hasWork.notify_all();
+
+   for( auto it = _workers.begin(); it != _workers.end(); ++it )
+      it->join();
+}
+
+
+void CheckPool::submit(shared_ptr<LinCombCheck> check)
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+
+   _hasRoom.wait(lock, [this] { return _queue.size() < _capacity; });
+   _queue.push_back(check);
+   lock.unlock();
+
+   _hasWork.notify_one();
+}
+
+
+bool CheckPool::finish(int before)
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+
+   _isIdle.wait(lock, [this] { return _queue.empty() && _busy == 0; });
+
+   if( !_failedCheck || _failedCheck->index >= before )
+      return true;
+
+   cerr << _failedCheck->errors;
+   if( _failedDerived )
+      printFailedLinComb(*_failedCheck, *_failedDerived);
+
+   return false;
+}
+
+
+void CheckPool::_work()
+{
+   for( ;; )
+   {
+      shared_ptr<LinCombCheck> check;
+      bool skip;
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+
+         _hasWork.wait(lock, [this] { return _stop || !_queue.empty(); });
+         if( _stop )
+            return;
+
+         check = _queue.front();
+         _queue.pop_front();
+         ++_busy;
+
+         // nothing to learn from derivations after a known failure
+         skip = _failedCheck && check->index > _failedCheck->index;
+      }
+      _hasRoom.notify_one();
+
+      shared_ptr<Constraint> derived;
+      bool success = skip || checkLinComb(*check, derived);
+
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+
+         // keep the earliest failure for reporting
+         if( !success && (!_failedCheck || check->index < _failedCheck->index) )
+         {
+            _failedCheck = check;
+            _failedDerived = derived;
+         }
+         if( !success )
+            _failed = true;
+         --_busy;
+      }
+      _isIdle.notify_all();
+   }
+}
+
+
+// Looks up the constraints of the multipliers of a lin/rnd derivation and determines the sense
+// of their combination
+bool resolveMultipliers(const DerivationRecord &record, int &sense, SVectorGMP &mult,
+                        std::ostream &errors)
+{
+
+   bool returnStatement = true;
+
+   sense = 0;
+   mult.clear();
+
+   for( size_t j = 0; j < record.numberOfMultipliers; ++j )
+   {
+      const Rational &a = record.multipliers[j];
+      int index = record.indices[j];
+
+      if( a == 0 ) continue; // ignore 0 multiplier
+
+      const Constraint* con = constraint.find(index);
+
+      if( con == nullptr )
+      {
+         errors << "Accessing released or unknown constraint: " << constraint.label(index) << endl;
+         returnStatement = false;
+         goto TERMINATE;
+      }
+
+      mult.append(index, a);
+
+      if( sense == 0 )
+      {
+         sense = con->getSense() * sgn(a);
+      }
+      else
+      {
+         int tmp = con->getSense() * sgn(a);
+         if( tmp != 0 && sense != tmp )
+         {
+            errors << "Coefficient has wrong sign for index " << index << endl;
+            returnStatement = false;
+            goto TERMINATE;
+         }
+      }
+   }
+
+   if( !record.referencesRead )
+   {
+      errors << "Error reading multiplier " << record.numberOfMultipliers << endl;
+      returnStatement = false;
+   }
+
+TERMINATE:
+   mult.compactify();
+   return returnStatement;
+}
+
+// Read and store constraints
+bool readConstraintCoefficients(CertificateInput &in, shared_ptr<SVectorGMP> &coefficients,
+                                std::ostream &errors)
+{
+   auto returnStatement = false;
+   long k = 0;
+   Token tmp;
+
+   coefficients->clear();
+
+   if( !in.next(tmp) )
+   {
+      errors << "Error reading number of elements " << endl;
+      goto TERMINATE;
+   }
+
+   if( tmp == "OBJ" ) // case that constraint = objective function
+   {
+      coefficients = objectiveCoefficients;
+      returnStatement = true;
+   }
+   else
+   {
+      if( !CertificateInput::toLong(tmp, k) || k < 0 )
+      {
+         errors << "Error reading number of elements " << endl;
+         goto TERMINATE;
+      }
+      else
+      {
+         int index = -1;
+
+         coefficients->reserve(std::min(k, long(numberOfVariables)));
+
+         for( long j = 0; j < k; j++ )
+         {
+            in >> index;
+            in >> coefficients->append(index);
+            if( in.fail() )
+            {
+               errors << "Error reading integer-rational pair " << endl;
+               goto TERMINATE;
+            }
+            else if( index < 0 || index >= numberOfVariables )
+            {
+               errors << "Index out of bounds: " << index << endl;
+               goto TERMINATE;
+            }
+         }
+         returnStatement = true;
+      }
+   }
+
+   coefficients->compactify();
+
+TERMINATE:
+   return returnStatement;
+}
+
+
+bool readConstraint(CertificateInput &in, string &label, int &sense, Rational &rhs,
+                    shared_ptr<SVectorGMP> &coefficients, std::ostream &errors)
+{
+
+   auto returnStatement = false;
+   char senseChar = 0;
+
+   in >> label >> senseChar;
+
+   if( !in.fail() )
+   {
+      if( senseChar == 'E' )
+         sense = 0;
+      else if( senseChar == 'L' )
+         sense = -1;
+      else if( senseChar == 'G' )
+         sense = 1;
+      else
+      {
+        errors << "Unknown sense for " << label << ": " << senseChar << endl;
+        goto TERMINATE;
+      }
+
+      in >> rhs;
+
+      if( !in.fail() )
+         returnStatement = readConstraintCoefficients(in, coefficients, errors);
+
+      if( !returnStatement ) errors << label <<   ": Error reading constraint " << endl;
+   }
+
+TERMINATE:
+   return returnStatement;
+}
+
+
+// con1 and con2 must be inequalities for an integer disjunction
+// e.g. mx <= d and mx >= d+1 such that the variables indexed by
+// the support of m are integers.   The function checks this.
+// a1 and a2 are assumptions.
+bool canUnsplit(  const Constraint &toDer, const int con1, const int a1,
+                  const int con2, const int a2, AssumptionSet &assumptionList, std::ostream &errors)
+{
+
+   bool returnStatement = false;
+
+   if( constraint.find(con1) == nullptr )
+   {
+      errors << "unsplitting released constraint: " << constraint.label(con1) << endl;
+      return false;
+   }
+   else if( constraint.find(con2) == nullptr )
+   {
+      errors << "unsplitting released constraint: " << constraint.label(con2) << endl;
+      return false;
+   }
+   else if( constraint.find(a1) == nullptr )
+   {
+      errors << "accessing released constraint: " << constraint.label(a1) << endl;
+      return false;
+   }
+   else if( constraint.find(a2) == nullptr )
+   {
+      errors << "accessing released constraint: " << constraint.label(a2) << endl;
+      return false;
+   }
+
+   const Constraint &c1 = constraint[con1];
+   const Constraint &c2 = constraint[con2];
+
+   const Constraint &branchAsm1 = constraint[a1];
+   const Constraint &branchAsm2 = constraint[a2];
+
+   if( c1.dominates(toDer) && c2.dominates(toDer) )
+   {
+      SVectorGMP asm1Coef, asm2Coef;
+      Rational asm1Rhs, asm2Rhs;
+
+      AssumptionSet asm1 = c1.getassumptionList();
+      AssumptionSet asm2 = c2.getassumptionList();
+
+      // remove the indices involved in unsplitting
+      if( !asm1.contains(a1) )
+         cout << "Warning: " << a1 << " not present in unsplit" << endl;
+      if( !asm2.contains(a2) )
+         cout << "Warning: " << a2 << " not present in unsplit" << endl;
+
+      asm1 = asm1.erase(a1);
+      asm2 = asm2.erase(a2);
+
+#ifndef NDEBUG
+      cout << "asm1: ";
+      for( auto it = asm1.begin(); it != asm1.end(); ++it ) {
+         cout << *it << " ";
+      }
+      cout << endl;
+
+      cout << "asm2: ";
+      for( auto it = asm2.begin(); it != asm2.end(); ++it ) {
+         cout << *it << " ";
+      }
+      cout << endl;
+#endif
+
+      assumptionList = asm1.unite(asm2);
+
+
+      // the constraints must have opposite senses
+      if( -1 != branchAsm1.getSense() * branchAsm2.getSense() )
+      {
+         errors << "canUnsplit: Failed sense requirement for assumptions" << endl;
+         errors << "branchAsm1 sense:: " << branchAsm1.getSense() << endl;
+         errors << "branchAsm2 sense:: " << branchAsm2.getSense() << endl;
+         goto TERMINATE;
+      }
+      else
+      {
+
+         // check if disjunction gives a tautology with respect to the variable
+         // integrality requirements
+         bool stat = true;
+         if( branchAsm1.getSense() < 0 )
+            stat = ((branchAsm1.getRhs() + 1) == branchAsm2.getRhs());
+         else // must be > 0
+            stat = (branchAsm1.getRhs() == (branchAsm2.getRhs() + 1));
+
+         if( !stat ) {
+            errors << branchAsm1.label() << " and " << branchAsm2.label()
+                   << " do not form a tautology" << endl;
+            goto TERMINATE;
+         };
+
+         shared_ptr<SVectorGMP> c1ptr = branchAsm1.coefSVec();
+         shared_ptr<SVectorGMP> c2ptr = branchAsm2.coefSVec();
+         if( (c1ptr == c2ptr) || (*c1ptr == *c2ptr) ) // coefSVec can both point to objectiveCoefficients
+         {
+
+            for( size_t k = 0; k < c1ptr->size(); ++k )
+            {
+               if( !isInt[c1ptr->index(k)] )
+               {
+                  errors << "canUnsplit: noninteger variable index " << c1ptr->index(k)
+                         << endl;
+                  goto TERMINATE;
+               }
+               else if( !isInteger(c1ptr->value(k)) )
+               {
+                  errors << "canUnsplit: noninteger coefficient for index "
+                         << c1ptr->index(k) << endl;
+                  goto TERMINATE;
+               }
+            }
+         }
+         else
+         {
+            errors << "canUnsplit: coefs of asm constraints differ" << endl;
+            goto TERMINATE;
+         }
+         returnStatement = true;
+      }
+   }
+
+TERMINATE:
+   return returnStatement;
+}
+
+
+// SparseVector methods
+template <class T>
+void SparseVector<T>::_sort()
+{
+   size_t n = _indices.size();
+   vector<size_t> order(n);
+
+   for( size_t k = 0; k < n; ++k )
+      order[k] = k;
+
+   // stable, so that the last of several values for the same index can be kept
+   std::stable_sort(order.begin(), order.end(),
+                    [this](size_t a, size_t b) { return _indices[a] < _indices[b]; });
+
+   vector<int> indices;
+   vector<T> values;
+   using std::swap;
+
+   indices.reserve(n);
+   values.reserve(n);
+
+   for( size_t k = 0; k < n; ++k )
+   {
+      if( k + 1 < n && _indices[order[k]] == _indices[order[k+1]] )
+         continue;
+
+      T &a = _values[order[k]];
+
+      if( a != 0 )
+      {
+         indices.push_back(_indices[order[k]]);
+         values.emplace_back();
+         swap(values.back(), a);
+      }
+   }
+
+   _indices.swap(indices);
+   _values.swap(values);
+   _compact = true;
+}
+
+
+template <class T>
+T SparseVector<T>::operator[](int index) const
+{
+   assert(_compact);
+
+   auto it = std::lower_bound(_indices.begin(), _indices.end(), index);
+
+   if( it == _indices.end() || *it != index )
+      return T(0);
+
+   return _values[it - _indices.begin()];
+}
+
+
+template <class T>
+bool SparseVector<T>::operator!=(const SparseVector<T> &other) const
+{
+   assert(_compact && other._compact);
+
+   if( this == &other )
+      return false;
+
+   // different hashes prove different content, equal hashes are compared in full
+   if( size() != other.size() || (_hashed && other._hashed && _hash != other._hash) )
+      return true;
+
+   if( size() > 0 && memcmp(_indices.data(), other._indices.data(), size() * sizeof(int)) != 0 )
+      return true;
+
+   for( size_t k = 0; k < size(); ++k )
+   {
+      if( _values[k] != other._values[k] )
+         return true;
+   }
+
+   return false;
+}
+
+
+template <class T>
+SparseVector<T> SparseVector<T>::operator-(const SparseVector<T> &other) const
+{
+   SparseVector<T> difference;
+   size_t k = 0;
+   size_t l = 0;
+
+   assert(_compact && other._compact);
+
+   difference.reserve(size() + other.size());
+
+   while( k < size() || l < other.size() )
+   {
+      if( l == other.size() || (k < size() && _indices[k] < other._indices[l]) )
+      {
+         difference.append(_indices[k], _values[k]);
+         ++k;
+      }
+      else if( k == size() || other._indices[l] < _indices[k] )
+      {
+         difference.append(other._indices[l], -other._values[l]);
+         ++l;
+      }
+      else
+      {
+         T d = _values[k] - other._values[l];
+
+         if( d != 0 )
+            difference.append(_indices[k], d);
+         ++k;
+         ++l;
+      }
+   }
+
+   // merged in order and without zeros
+   difference._compact = true;
+
+   return difference;
+}
+
+
+static inline uint64_t hashCombine(uint64_t h, uint64_t w)
+{
+   h ^= w + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+   return h * 0xbf58476d1ce4e5b9ULL;
+}
+
+
+static uint64_t hashMpz(uint64_t h, mpz_srcptr z)
+{
+   size_t n = mpz_size(z);
+
+   h = hashCombine(h, uint64_t(mpz_sgn(z)) + n);
+   for( size_t k = 0; k < n; ++k )
+      h = hashCombine(h, mpz_getlimbn(z, k));
+
+   return h;
+}
+
+
+static uint64_t hashValue(uint64_t h, const mpq_class &q)
+{
+   return hashMpz(hashMpz(h, q.get_num_mpz_t()), q.get_den_mpz_t());
 }
 
 
-inline mpq_class ceil(const mpq_class &q)
+// bytes allocated by GMP outside of the number object
+static size_t limbMemory(const mpq_class &q)
 {
-   mpz_t z;
-   mpq_class result;
-   mpz_init (z);
-   mpz_cdiv_q(z, q.get_num_mpz_t(), q.get_den_mpz_t()); // Divide numerator by denominator and ceil the result
-   result = mpz_class(z);
-   mpz_clear (z);
-   return result;
+   return (mpz_size(q.get_num_mpz_t()) + mpz_size(q.get_den_mpz_t())) * sizeof(mp_limb_t);
 }
 
-bool isInteger(const mpq_class &q)
+
+#ifdef VIPR_HAVE_HYBRID_RATIONAL
+// values have a unique representation, so small values can be hashed as they are
+static inline uint64_t hashValue(uint64_t h, const HybridRational &q)
 {
-   return (q == floor(q));
+   return q.isSmall() ? hashCombine(hashCombine(h, uint64_t(q.num())), uint64_t(q.den()))
+                      : hashValue(h, q.bigValue());
 }
 
 
-bool readLinComb( int &sense, mpq_class &rhs, shared_ptr<SVectorGMP> coefficients,
-                  int currentConstraintIndex,SVectorBool &assumptionList)
+static inline size_t limbMemory(const HybridRational &q)
 {
-   bool returnStatement = true;
+   return q.isSmall() ? 0 : sizeof(mpq_class) + limbMemory(q.bigValue());
+}
+#endif
 
-   SVectorGMP mult;
 
-   if( !readMultipliers(sense, mult) )
-   {
-      returnStatement = false;
-   }
-   else
+template <class T>
+uint64_t SparseVector<T>::hash()
+{
+   if( !_hashed )
    {
-      rhs = 0;
-      coefficients->clear();
-      assumptionList.clear();
-      mpq_class t;
-
-      for( auto it = mult.begin(); it != mult.end(); ++it )
-      {
-         auto index = it->first;
-         auto a = it->second;
+      uint64_t h = hashCombine(0, size());
 
-         auto myassumptionList = constraint[index].getassumptionList();
+      compactify();
 
-         for( auto it2 = myassumptionList.begin(); it2 != myassumptionList.end(); ++it2 )
-            assumptionList[it2->first] = true;
+      for( size_t k = 0; k < size(); ++k )
+         h = hashValue(hashCombine(h, uint64_t(_indices[k])), _values[k]);
 
-         const Constraint &con = constraint[index];
+      _hash = h ^ (h >> 31);
+      _hashed = true;
+   }
 
-         if( con.isTrashed() )
-         {
-            cerr << "Accessing trashed constraint: " << con.label() << endl;
-            returnStatement = false;
-         }
-         else
-         {
-            shared_ptr<SVectorGMP> c = constraint[index].coefSVec();
+   return _hash;
+}
 
-            for( auto itr = c->begin(); itr != c->end(); ++itr )
-               (*coefficients)[ itr->first ] += a * itr->second;
 
-            rhs += a * constraint[index].getRhs();
+template <class T>
+size_t SparseVector<T>::memoryUsage() const
+{
+   size_t bytes = sizeof(SparseVector<T>) + _indices.capacity() * sizeof(int)
+                  + _values.capacity() * sizeof(T);
 
-            if( (constraint[index].getMaxRefIdx() <= currentConstraintIndex) &&
-                (constraint[index].getMaxRefIdx() >= 0) )
-               constraint[index].trash();
-         }
-      }
-   }
+   for( auto it = _values.begin(); it != _values.end(); ++it )
+      bytes += limbMemory(*it);
 
-   return returnStatement;
+   return bytes;
 }
 
 
-bool readMultipliers(int &sense, SVectorGMP &mult)
+// RowTable methods
+shared_ptr<SVectorGMP> RowTable::intern(const shared_ptr<SVectorGMP> &row)
 {
+   uint64_t hash = row->hash();
+   auto range = _rows.equal_range(hash);
 
-   int k;
-   bool returnStatement = true;
+   ++_numberOfRows;
 
-   sense = 0;
-   mult.clear();
+   for( auto it = range.first; it != range.second; ++it )
+   {
+      shared_ptr<SVectorGMP> stored = it->second.lock();
+
+      if( stored == row )
+         return row;
+      else if( stored && *stored == *row )
+      {
+         _bytesSaved += row->memoryUsage();
+         return stored;
+      }
+   }
 
-   certificateFile >> k;
+   ++_numberOfUniqueRows;
+   _rows.emplace(hash, row);
 
-   for( auto j = 0; j < k; ++j )
+   if( _rows.size() >= _sweepSize )
    {
-      mpq_class a;
-      int index;
+      _sweep();
+      _sweepSize = std::max(size_t(1024), 2 * _rows.size());
+   }
 
-      certificateFile >> index >> a;
+   return row;
+}
 
-      if( a == 0 ) continue; // ignore 0 multiplier
 
-      mult[index] = a;
+void RowTable::_sweep()
+{
+   for( auto it = _rows.begin(); it != _rows.end(); )
+   {
+      if( it->second.expired() )
+         it = _rows.erase(it);
+      else
+         ++it;
+   }
+}
 
-      if( sense == 0 )
-      {
-         sense = constraint[index].getSense() * sgn(a);
-      }
+
+// use merge of the sorted index arrays
+Rational scalarProduct(shared_ptr<SVectorGMP> u, shared_ptr<SVectorGMP> v)
+{
+   Rational product = 0;
+   size_t k = 0;
+   size_t l = 0;
+
+   while( k < u->size() && l < v->size() )
+   {
+      if( u->index(k) < v->index(l) )
+         ++k;
+      else if( v->index(l) < u->index(k) )
+         ++l;
       else
       {
-         int tmp = constraint[index].getSense() * sgn(a);
-         if( tmp != 0 && sense != tmp )
-         {
-            cerr << "Coefficient has wrong sign for index " << index << endl;
-            returnStatement = false;
-            goto TERMINATE;
-         }
+         product += u->value(k) * v->value(l);
+         ++k;
+         ++l;
       }
    }
 
-TERMINATE:
-   return returnStatement;
+   return product;
 }
 
-// Read and store constraints
-bool readConstraintCoefficients(shared_ptr<SVectorGMP> &coefficients)
+
+// Copies the rows of the CON section, which are all live while the SOL section is read
+void buildConstraintMatrix( ConstraintMatrix &matrix )
 {
-   auto returnStatement = false;
-   int k = 0;
-   string tmp;
+   size_t numberOfNonzeros = 0;
 
-   coefficients->clear();
-   certificateFile >> tmp;
+   for( int j = 0; j < numberOfConstraints; ++j )
+      numberOfNonzeros += constraint[j].coefSVec()->size();
 
-   if( tmp == "OBJ" ) // case that constraint = objective function
+   matrix.rowStart.reserve(numberOfConstraints + 1);
+   matrix.columns.reserve(numberOfNonzeros);
+   matrix.values.reserve(numberOfNonzeros);
+   matrix.sense.reserve(numberOfConstraints);
+   matrix.rhs.reserve(numberOfConstraints);
+
+   for( int j = 0; j < numberOfConstraints; ++j )
    {
-      coefficients = objectiveCoefficients;
-      returnStatement = true;
+      Constraint &con = constraint[j];
+      const SVectorGMP &row = *con.coefSVec();
+
+      for( size_t k = 0; k < row.size(); ++k )
+      {
+         matrix.columns.push_back(row.index(k));
+         matrix.values.push_back(row.value(k));
+      }
+      matrix.rowStart.push_back(matrix.columns.size());
+      matrix.sense.push_back(con.getSense());
+      matrix.rhs.push_back(con.getRhs());
    }
-   else
+}
+
+
+// Computes the activities of rows first to last - 1 for the dense solution x and records
+// their largest violation and the first violated row in result
+void checkRows( const ConstraintMatrix &matrix, const vector<Rational> &x, int first, int last,
+                SolutionCheck &result )
+{
+   Rational activity;
+   Rational violation;
+
+   for( int j = first; j < last; ++j )
    {
-      k = atoi(tmp.c_str());
+      activity = 0;
 
-      if( certificateFile.fail() )
+      for( size_t p = matrix.rowStart[j]; p < matrix.rowStart[j + 1]; ++p )
       {
-         cerr << "Error reading number of elements " << endl;
-         goto TERMINATE;
+         const Rational &value = x[matrix.columns[p]];
+
+         if( value != 0 )
+            activity += matrix.values[p] * value;
       }
+
+      if( matrix.sense[j] < 0 )
+         violation = activity - matrix.rhs[j];
+      else if( matrix.sense[j] > 0 )
+         violation = matrix.rhs[j] - activity;
       else
-      {
-         for( int j = 0; j < k; j++ )
-         {
-            int index;
-            mpq_class a;
+         violation = (activity >= matrix.rhs[j] ? activity - matrix.rhs[j] : matrix.rhs[j] - activity);
 
-            certificateFile >> index >> a;
-            if( certificateFile.fail() )
-            {
-               cerr << "Error reading integer-rational pair " << endl;
-               goto TERMINATE;
-            }
-            else if( index < 0 || index >= numberOfVariables )
-            {
-               cerr << "Index out of bounds: " << index << endl;
-               goto TERMINATE;
-            }
-            (*coefficients)[index] = a;
-         }
-         returnStatement = true;
+      if( violation > 0 )
+      {
+         if( result.violatedRow < 0 )
+            result.violatedRow = j;
+         if( violation > result.maxViolation )
+            result.maxViolation = violation;
       }
    }
-
-   coefficients->compactify();
-
-TERMINATE:
-   return returnStatement;
 }
 
 
-bool readConstraint(string &label, int &sense, mpq_class &rhs, shared_ptr<SVectorGMP> &coefficients)
+// Checks all solutions against all rows.  The solutions are scattered into dense vectors in
+// batches of one solution per thread, and the threads take blocks of rows of any solution of
+// the batch, so that a single solution is checked in parallel as well
+void checkSolutions( const ConstraintMatrix &matrix, const vector<shared_ptr<SVectorGMP>> &solutions,
+                     vector<SolutionCheck> &results )
 {
+   const int blockSize = 1024;
+   int numberOfRows = int(matrix.sense.size());
+   int numberOfBlocks = std::max(1, (numberOfRows + blockSize - 1) / blockSize);
+   size_t batchSize = std::min(size_t(numberOfThreads), solutions.size());
+   vector<vector<Rational>> dense(batchSize, vector<Rational>(numberOfVariables));
 
-   auto returnStatement = false;
-   char senseChar;
-
-   certificateFile >> label >> senseChar;
+   results.assign(solutions.size(), SolutionCheck());
 
-   if( !certificateFile.fail() )
+   for( size_t first = 0; first < solutions.size(); first += batchSize )
    {
-      if( senseChar == 'E' )
-         sense = 0;
-      else if( senseChar == 'L' )
-         sense = -1;
-      else if( senseChar == 'G' )
-         sense = 1;
-      else
+      size_t last = std::min(first + batchSize, solutions.size());
+      int numberOfItems = int(last - first) * numberOfBlocks;
+      vector<SolutionCheck> blocks(numberOfItems);
+      std::atomic<int> next(0);
+
+      for( size_t i = first; i < last; ++i )
       {
-        cerr << "Unknown sense for " << label << ": " << senseChar << endl;
-        goto TERMINATE;
+         for( size_t k = 0; k < solutions[i]->size(); ++k )
+            dense[i - first][solutions[i]->index(k)] = solutions[i]->value(k);
       }
 
-      certificateFile >> rhs;
-
-      if( !certificateFile.fail() )
-         returnStatement = readConstraintCoefficients(coefficients);
-
-      if( !returnStatement ) cerr << label <<   ": Error reading constraint " << endl;
-   }
+      auto work = [&]() {
+         for( int item = next++; item < numberOfItems; item = next++ )
+         {
+            int b = item % numberOfBlocks;
+            auto start = std::chrono::steady_clock::now();
 
-TERMINATE:
-   return returnStatement;
-}
+            checkRows(matrix, dense[item / numberOfBlocks], b * blockSize,
+               std::min(numberOfRows, (b + 1) * blockSize), blocks[item]);
 
+            std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+            blocks[item].seconds = duration.count();
+         }
+      };
 
-// con1 and con2 must be inequalities for an integer disjunction
-// e.g. mx <= d and mx >= d+1 such that the variables indexed by
-// the support of m are integers.   The function checks this.
-// a1 and a2 are assumptions.
-bool canUnsplit(  Constraint &toDer, const int con1, const int a1,
-                  const int con2, const int a2, SVectorBool &assumptionList)
-{
+      vector<std::thread> threads;
 
-   bool returnStatement = false;
+      for( int t = 1; t < std::min(numberOfThreads, numberOfItems); ++t )
+         threads.emplace_back(work);
+      work();
+      for( auto &thread : threads )
+         thread.join();
 
-   const Constraint &c1 = constraint[con1];
-   const Constraint &c2 = constraint[con2];
+      // blocks of a solution are merged in row order, so the first violated row is the smallest
+      for( int item = 0; item < numberOfItems; ++item )
+      {
+         SolutionCheck &result = results[first + item / numberOfBlocks];
 
-   const Constraint &branchAsm1 = constraint[a1];
-   const Constraint &branchAsm2 = constraint[a2];
+         if( result.violatedRow < 0 )
+            result.violatedRow = blocks[item].violatedRow;
+         if( blocks[item].maxViolation > result.maxViolation )
+            result.maxViolation = blocks[item].maxViolation;
+         result.seconds += blocks[item].seconds;
+      }
 
-   if( c1.isTrashed() )
-   {
-      cerr << "unsplitting trashed constraint: " << c1.label() << endl;
-      goto TERMINATE;
-   }
-   else if( c2.isTrashed() )
-   {
-      cerr << "unsplitting trashed constraint: " << c2.label() << endl;
-      goto TERMINATE;
+      for( size_t i = first; i < last; ++i )
+      {
+         for( size_t k = 0; k < solutions[i]->size(); ++k )
+            dense[i - first][solutions[i]->index(k)] = 0;
+      }
    }
+}
 
-   if( c1.dominates(toDer) && c2.dominates(toDer) )
-   {
-      SVectorGMP asm1Coef, asm2Coef;
-      mpq_class asm1Rhs, asm2Rhs;
-
-      SVectorBool asm1 = c1.getassumptionList();
-      SVectorBool asm2 = c2.getassumptionList();
 
-      // remove the indices involved in unsplitting
-      if (asm1.find(a1) == asm1.end())
-         cout << "Warning: " << a1 << " not present in unsplit" << endl;
-      if (asm2.find(a2) == asm2.end())
-         cout << "Warning: " << a2 << " not present in unsplit" << endl;
+// AssumptionSet methods
+AssumptionSet AssumptionSet::singleton(int index)
+{
+   vector<int> indices(1, index);
 
-      asm1.erase(a1);
-      asm2.erase(a2);
+   return _intern(indices);
+}
 
-      assumptionList.clear();
-      assumptionList = asm1;
 
-#ifndef NDEBUG
-      cout << "asm1: ";
-      for( auto it = asm1.begin(); it != asm1.end(); ++it ) {
-         cout << it->first << " ";
-      }
-      cout << endl;
+// merge of the two sorted index arrays; no new set is created if one contains the other
+AssumptionSet AssumptionSet::unite(const AssumptionSet &other) const
+{
+   if( _node == other._node || other.empty() )
+      return *this;
+   else if( empty() )
+      return other;
 
-      cout << "asm2: ";
-      for( auto it = asm2.begin(); it != asm2.end(); ++it ) {
-         cout << it->first << " ";
-      }
-      cout << endl;
-#endif
+   vector<int> indices;
 
-      for( auto it = asm2.begin(); it != asm2.end(); ++it )
-         assumptionList[it->first] = true;
+   indices.reserve(size() + other.size());
+   std::set_union(begin(), end(), other.begin(), other.end(), std::back_inserter(indices));
 
-      if( branchAsm1.isTrashed() )
-      {
-         cerr << "accessing trashed constraint: " << branchAsm1.label() << endl;
-         goto TERMINATE;
-      }
-      else if( c2.isTrashed() )
-      {
-         cerr << "accessing trashed constraint: " << c2.label() << endl;
-         goto TERMINATE;
-      }
+   if( indices.size() == size() )
+      return *this;
+   else if( indices.size() == other.size() )
+      return other;
 
+   return _intern(indices);
+}
 
-      // the constraints must have opposite senses
-      if( -1 != branchAsm1.getSense() * branchAsm2.getSense() )
-      {
-         cerr << "canUnsplit: Failed sense requirement for assumptions" << endl;
-         cerr << "branchAsm1 sense:: " << branchAsm1.getSense() << endl;
-         cerr << "branchAsm2 sense:: " << branchAsm2.getSense() << endl;
-         goto TERMINATE;
-      }
-      else
-      {
 
-         // check if disjunction gives a tautology with respect to the variable
-         // integrality requirements
-         bool stat = true;
-         if( branchAsm1.getSense() < 0 )
-            stat = ((branchAsm1.getRhs() + 1) == branchAsm2.getRhs());
-         else // must be > 0
-            stat = (branchAsm1.getRhs() == (branchAsm2.getRhs() + 1));
+AssumptionSet AssumptionSet::erase(int index) const
+{
+   auto it = std::lower_bound(begin(), end(), index);
 
-         if( !stat ) {
-            cerr << branchAsm1.label() << " and " << branchAsm2.label()
-                 << " do not form a tautology" << endl;
-            goto TERMINATE;
-         };
+   if( it == end() || *it != index )
+      return *this;
 
-         shared_ptr<SVectorGMP> c1ptr = branchAsm1.coefSVec();
-         shared_ptr<SVectorGMP> c2ptr = branchAsm2.coefSVec();
-         if( (c1ptr == c2ptr) || (*c1ptr == *c2ptr) ) // coefSVec can both point to objectiveCoefficients
-         {
+   vector<int> indices(begin(), it);
 
-            for( auto it = c1ptr->begin(); it != c1ptr->end(); ++it )
-            {
-               if( !isInt[it->first] )
-               {
-                  cerr << "canUnsplit: noninteger variable index " << it->first
-                         << endl;
-                  goto TERMINATE;
-               }
-               else if( !isInteger(it->second) )
-               {
-                  cerr << "canUnsplit: noninteger coefficient for index "
-                         << it->first << endl;
-                  goto TERMINATE;
-               }
-            }
-         }
-         else
-         {
-            cerr << "canUnsplit: coefs of asm constraints differ" << endl;
-            goto TERMINATE;
-         }
-         returnStatement = true;
-      }
-   }
+   indices.insert(indices.end(), it + 1, end());
 
-TERMINATE:
-   return returnStatement;
+   return _intern(indices);
 }
 
 
-// SVectorGMP methods
-bool SVectorGMP::operator!=(SVectorGMP &other)
+AssumptionSet AssumptionSet::_intern(vector<int> &indices)
 {
-   bool returnStatement = false;
+   AssumptionSet set;
 
-   SVectorGMP &cf1 = *this;
-   SVectorGMP &cf2 = other;
+   if( indices.empty() )
+      return set;
 
-   // get rid of all zero entries
-   cf1.compactify();
-   cf2.compactify();
+   Node *node = new Node;
+   size_t hash = indices.size();
 
-   if( cf1.size() != cf2.size() )
-   {
-      returnStatement = true;
-   }
-   else
+   for( auto it = indices.begin(); it != indices.end(); ++it )
+      hash ^= size_t(*it) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+
+   node->indices.swap(indices);
+   node->hash = hash;
+
+   std::lock_guard<std::mutex> lock(_tableMutex);
+   auto found = _table.find(node);
+
+   if( found != _table.end() )
    {
-      for( auto it1 = cf1.begin(); it1 != cf1.end(); ++it1 )
+      set._node = found->second.lock();
+
+      if( set._node )
       {
-         auto it2 = cf2.find(it1->first);
-         if( it2 == cf2.end() || it2->second != it1->second )
-         {
-            returnStatement = true;
-            break;
-         }
+         delete node;
+         return set;
       }
+
+      // the stored set is being released, replace it by the new one
+      _table.erase(found);
    }
 
-   return returnStatement;
+   set._node = shared_ptr<const Node>(node, _release);
+   _table.emplace(node, set._node);
+
+   return set;
 }
 
 
-// use non-sparse vector for v to reduce lookup time
-mpq_class scalarProduct(shared_ptr<SVectorGMP> u, shared_ptr<SVectorGMP> v)
+void AssumptionSet::_release(const Node *node)
 {
-   mpq_class product = 0;
-
-   for( auto it = u->begin(); it != u->end(); ++it )
    {
-      auto it2 = v->find(it->first);
-      if( it2 != v->end() )
-         product += it->second * it2->second;
+      std::lock_guard<std::mutex> lock(_tableMutex);
+      auto found = _table.find(node);
+
+      // the entry may already belong to an equal set created after this one expired
+      if( found != _table.end() && found->first == node )
+         _table.erase(found);
    }
 
-   return product;
+   delete node;
 }
 
 
 // Constraint methods
-bool Constraint::round()
+template <class T>
+bool LinearConstraint<T>::round(std::ostream &errors)
 {
    bool returnStatement = true;
 
-   for( auto it = _coefficients->begin(); it != _coefficients->end(); ++it )
+   for( size_t k = 0; k < _coefficients->size(); ++k )
    {
-      auto j = it->first;
-      auto a = it->second;
+      auto j = _coefficients->index(k);
+      const T &a = _coefficients->value(k);
 
       if( isInt[j] )
       {   // needs to be an integer variable
          if( !isInteger(a) )
          {
-            cerr << "Coefficient of integer variable with index "
-                 << j << " is not an integer" << endl;
+            errors << "Coefficient of integer variable with index "
+                   << j << " is not an integer" << endl;
             returnStatement = false;
             goto TERMINATE;
          }
@@ -1562,46 +3752,43 @@ TERMINATE:
 }
 
 
-bool Constraint::_isFalsehood()
+template <class T>
+bool LinearConstraint<T>::isContradiction(int sense, const T &rhs)
 {
-   bool returnStatement = false;
+   return ((sense <= 0) && (rhs < 0)) || ((sense >= 0) && (rhs > 0));
+}
 
-   if( _coefficients->size() == 0 )
-   {
-      if( ((getSense() <= 0) && (_rhs < 0)) || ((getSense() >= 0) && (_rhs > 0)) )
-         returnStatement = true;
-   }
 
-   return returnStatement;
+template <class T>
+bool LinearConstraint<T>::impliesRhs(int sense, const T &rhs, int otherSense, const T &otherRhs)
+{
+   return (otherSense > 0 && sense >= 0 && rhs >= otherRhs)
+      || (otherSense < 0 && sense <= 0 && rhs <= otherRhs)
+      || (otherSense == 0 && sense == 0 && rhs == otherRhs);
 }
 
 
-bool Constraint::dominates(Constraint &other) const
+template <class T>
+bool LinearConstraint<T>::_isFalsehood()
 {
-   bool returnStatement = false;
+   return _coefficients->size() == 0 && isContradiction(getSense(), _rhs);
+}
 
+
+template <class T>
+bool LinearConstraint<T>::dominates(const LinearConstraint<T> &other) const
+{
    if( this->isFalsehood() )
-   {
-      returnStatement = true;
-   }
-   else if( *(this->_coefficients) == *(other._coefficients) )  // force object comparison
-   {
-      if( (other.getSense() > 0 && this->getSense() >= 0 &&
-             this->_rhs >= other._rhs)
-         || (other.getSense() < 0 && this->getSense() <= 0 &&
-             this->_rhs <= other._rhs)
-         || (other.getSense() == 0 && this->getSense() == 0 &&
-             this->_rhs == other._rhs) )
-      {
-         returnStatement = true;
-      }
-   }
+      return true;
 
-   return returnStatement;
+   // compares the rows without modifying them, entry by entry after the sizes and hashes
+   return *(this->_coefficients) == *(other._coefficients)
+      && impliesRhs(this->getSense(), this->_rhs, other.getSense(), other._rhs);
 }
 
 
-bool Constraint::isTautology() {
+template <class T>
+bool LinearConstraint<T>::isTautology() {
    bool returnStatement = false;
 
    if( _coefficients->size() == 0 )
@@ -1617,9 +3804,10 @@ bool Constraint::isTautology() {
 }
 
 
-void Constraint::print() {
+template <class T>
+void LinearConstraint<T>::print() {
    bool first = true;
-   mpq_class myCoefficient;
+   T myCoefficient;
    cout.precision(std::numeric_limits<double>::max_digits10);
 
    int count = 0;
@@ -1627,10 +3815,10 @@ void Constraint::print() {
    if( _isAssumption )
       cout << "Is assumption: ";
 
-   for( auto it = _coefficients->begin(); it != _coefficients->end(); ++it )
+   for( size_t k = 0; k < _coefficients->size(); ++k )
    {
-      auto index = it->first;
-      auto a = it->second;
+      auto index = _coefficients->index(k);
+      const T &a = _coefficients->value(k);
 
       myCoefficient = abs(a);
 
@@ -1676,8 +3864,8 @@ void Constraint::print() {
       cout << " -- assumptions: " << endl;
       for( auto it = _assumptionList.begin(); it != _assumptionList.end(); ++it )
       {
-         auto index = it->first;
-         cout << "   "<< it->first << ": " << constraint[index].label() << endl;
+         auto index = *it;
+         cout << "   "<< index << ": " << constraint.label(index) << endl;
       }
       cout << endl;
    }
@@ -31,7 +31,22 @@
 #include <vector>
 #include <map>
 #include <limits>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <memory>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <functional>
 #include "soplex.h"
+#include "vipraccum.h"
+#include "viprstream.h"
 
 using namespace std;
 using namespace soplex;
@@ -62,8 +77,8 @@ class SVectorRat : public map<int, Rational>
 
 
 // Globals
-ifstream certificateFile;
-ofstream completedFile;
+InputFile certificateFile;
+OutputFile completedFile;
 bool debugmode = false;
 bool usesoplex = true;
 int numberOfVariables = 0; // number of variables
@@ -78,24 +93,189 @@ vector<string> variables; // variable names
 vector<bool> isInt; // integer variable indices
 DSVectorPointer ObjCoeff(make_shared<DSVectorRational>()); // sparse vector of objective coefficients
 
-vector<long> currentlyActiveDerivations; // tracks curr. active derivations (for completing lin)
+int numberOfThreads = 1; // threads completing incomplete derivations
+bool floatingPointFirst = true; // try to complete derivations from a floating-point solve first
+const double FLOATING_POINT_TOLERANCE = 1e-9; // feasibility/optimality tolerance of that solve
+const long MAX_RATIONALIZE_DENOMINATOR = 1L << 24; // largest denominator of rounded multipliers
+bool reuseCompletions = true; // reuse the multipliers of equivalent completions
+const size_t MAX_CACHED_COMPLETIONS = 1 << 16; // completions whose multipliers are kept for reuse
+
+// statistics of completing incomplete lin derivations
+long numberOfCompletions = 0;
+long numberOfWarmStarts = 0; // completions started from the basis of the previous one
+long totalIterations = 0;
+long totalRowsRemoved = 0;
+long totalRowsAdded = 0;
+double completionTime = 0.0; // seconds spent updating the LP and solving it
+long numberOfFloatingPointCompletions = 0; // completions verified from a floating-point solve
+long numberOfExactSolves = 0;
+double floatingPointTime = 0.0; // seconds spent in floating-point solves, verified or not
+double exactTime = 0.0; // seconds spent in exact solves
+long numberOfCacheHits = 0; // completions that reused the multipliers of an equivalent one
+long numberOfCacheRejects = 0; // reused multipliers that did not derive the constraint
+long numberOfFarkasProofs = 0; // completions whose LP was infeasible
 
 vector<tuple<DSVectorPointer, Rational, int>> constraints; // all constraints, including derived ones
 
 struct lpIndex { long idx; bool isRowId; };
-bool operator< ( lpIndex a, lpIndex b ) {
-   return make_pair( a.idx, a.isRowId ) < make_pair( b.idx, b.isRowId );
-}
 
 typedef pair<long, long> certIndices;
-map< lpIndex, certIndices> correspondingCertRow; // maps each row/var of the LP to its active con/asm
-map< lpIndex, certIndices> originalCertRow; // maps each row/var of the LP to its original con/asm
+vector<certIndices> correspondingCertRow; // con/asm of each row of the LP
+vector<certIndices> correspondingCertCol; // con/asm bounding each var of the LP from below/above
+vector<certIndices> originalCertCol; // original bounds of each var of the LP
 VectorRational dualmultipliers(0);
 VectorRational reducedCosts(0);
 vector<tuple<Rational,Rational,long>> lowerBounds; // rational boundval, multiplier, long certindec
 vector<tuple<Rational,Rational,long>> upperBounds; // rational boundval, multiplier, long certindex
 
-map< long, lpIndex > correspondingLpData; // maps each certificate row to the corresponding lp Data
+// An incomplete lin derivation, completed by solving an LP over the CON rows and the active
+// derivations it lists.  Everything the LP needs is copied when the derivation is read, such
+// that the completion can be computed on any thread
+struct Completion
+{
+   string label;
+   DSVectorPointer objective;
+   int objSense;                 // SoPlex::OBJSENSE_MINIMIZE or SoPlex::OBJSENSE_MAXIMIZE
+   int sense;                    // stated sense and side of the derivation
+   Rational rhs;
+   vector<long> active;          // indices of the active derivations, sorted
+   vector<tuple<DSVectorPointer, Rational, int>> activeConstraints; // row, rhs and sense of each
+   long derHierarchy;
+   shared_ptr<Completion> equivalent; // earlier completion of the same LP, nullptr if none
+
+   // result, valid once done is set
+   std::atomic<bool> done{false};
+   bool success = false;
+   string output;                // text of the completed derivation
+   string messages;              // debug output
+   string warnings;
+   long iterations = 0;
+   double seconds = 0.0;
+   bool warmStart = false;
+   long rowsRemoved = 0;
+   long rowsAdded = 0;
+   bool floatingPoint = false;   // verified from the floating-point solve
+   bool exactSolve = false;
+   double floatingPointSeconds = 0.0;
+   double exactSeconds = 0.0;
+   bool cacheHit = false;        // multipliers of an equivalent completion were reused
+   bool cacheReject = false;     // an equivalent completion was found, but its multipliers failed
+   bool solved = false;          // the LP was solved and reasoningRow holds its multipliers
+   bool farkas = false;          // reasoningRow is a Farkas proof of an infeasible LP
+   DSVectorRational reasoningRow;
+};
+
+// A copy of the LP of the CON section together with the rows of the derivations it currently
+// holds.  Consecutive completions on one copy only exchange the rows that differ
+struct CompletionLP
+{
+   CompletionLP(const SoPlex &baselp)
+      : lp(baselp), certRow(correspondingCertRow), certCol(correspondingCertCol) {}
+
+   SoPlex lp;
+   vector<long> active;                    // derivations whose rows are in lp, sorted
+   vector<lpIndex> lpData;                 // row or var of each active derivation
+   vector<certIndices> certRow;            // con/asm of each row of lp
+   vector<certIndices> certCol;            // con/asm bounding each var of lp from below/above
+   const vector<tuple<DSVectorPointer, Rational, int>>* conConstraints; // the CON section
+};
+
+// Completes incomplete derivations on worker threads with one copy of the LP each.  With a
+// single thread, completions are computed in the calling thread when they are submitted.  The
+// copies are made at the first submission, when the LP of the CON section is complete.
+// Completions are dealt to the copies in turn, such that every copy solves the same sequence of
+// LPs in every run and the completed certificate does not depend on the thread schedule
+class CompletionPool
+{
+   public:
+      CompletionPool(const SoPlex &baselp, int numberOfThreads)
+         : _baselp(baselp), _numberOfThreads(numberOfThreads) {}
+      ~CompletionPool();
+
+      void submit(const shared_ptr<Completion> &completion);
+      void wait(const Completion &completion); // until the completion is done or the pool stops
+
+   private:
+      void _start();
+      void _work(size_t index);
+
+      const SoPlex &_baselp;
+      int _numberOfThreads;
+      vector<tuple<DSVectorPointer, Rational, int>> _conConstraints;
+      vector<unique_ptr<CompletionLP>> _lps;
+      vector<thread> _workers;
+      mutex _mutex;
+      condition_variable _hasWork;
+      condition_variable _isDone;
+      vector<deque<shared_ptr<Completion>>> _queues; // completions to do on each copy
+      size_t _next = 0;                      // copy of the next submitted completion
+      bool _stop = false;
+};
+
+// Keeps the completed certificate in derivation order while completions are computed on other
+// threads.  It replaces the stream buffer of the given stream, such that text written to the
+// stream is appended to the last segment, and every submitted completion starts a new segment
+// whose output is written in front of it once the completion is done
+class OrderedOutputBuf : public std::streambuf
+{
+   public:
+      OrderedOutputBuf(ostream &stream) : _stream(stream), _target(stream.rdbuf(this)), _segments(1) {}
+      ~OrderedOutputBuf() { _stream.rdbuf(_target); }
+
+      void append(const shared_ptr<Completion> &completion);
+
+      // writes everything up to the first completion that is not done, waiting for completions
+      // while more than maxPending are not written; false if a completion failed
+      bool drain(CompletionPool &pool, size_t maxPending);
+
+   protected:
+      int overflow(int c) override;
+      streamsize xsputn(const char* s, streamsize n) override;
+
+   private:
+      struct Segment
+      {
+         shared_ptr<Completion> completion; // written before text
+         string text;
+      };
+
+      ostream &_stream;
+      std::streambuf* _target;
+      deque<Segment> _segments;
+      size_t _pending = 0;                  // completions not written yet
+};
+
+// Completions looked up by objective, sense and active derivations.  Sibling nodes of a
+// branch-and-bound tree often complete the same row over the same derivations, and such
+// completions reuse the multipliers of the first one after checking them exactly for their own
+// side.  Lookups are made when the derivations are read, in the order of the certificate, such
+// that the same completions are reused in every run.  The oldest entries are dropped when more
+// than maxSize are stored
+class CompletionCache
+{
+   public:
+      CompletionCache(size_t maxSize) : _maxSize(maxSize) {}
+
+      // an earlier equivalent completion; if there is none, nullptr is returned and the
+      // completion is stored for later ones
+      shared_ptr<Completion> findOrInsert(const shared_ptr<Completion> &completion);
+
+   private:
+      struct Entry
+      {
+         size_t hash;
+         shared_ptr<Completion> completion;
+      };
+
+      static size_t _hash(const Completion &completion);
+      static bool _equal(const Completion &first, const Completion &second);
+
+      size_t _maxSize;
+      list<Entry> _entries;                 // oldest first
+      unordered_multimap<size_t, list<Entry>::iterator> _index;
+};
+
+CompletionCache completionCache(MAX_CACHED_COMPLETIONS);
 
 // Forward Declaration
 void modifyFileName(string &path, const string &newExtension);
@@ -110,12 +290,26 @@ bool processSOL();
 bool processDER(SoPlex &workinglp);
 bool getConstraints(SoPlex &workinglp, string &consense, Rational &rhs, int &activeConstraint);
 bool derisasm();
-bool derislin(SoPlex &workinglp, DSVectorPointer row, string &consense, Rational &rhs, string &label);
+bool derislin(CompletionPool &pool, OrderedOutputBuf &output, DSVectorPointer row, string &consense,
+              Rational &rhs, string &label);
 bool derisrnd();
 bool derisuns();
 bool derissol();
-bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &derToAdd, string &label);
-bool printReasoningToCertificate(DVectorRational &dualmultipliers, DVectorRational &reducedcosts);
+bool completeLin(CompletionLP &lp, Completion &completion, ostream &output, ostream &messages,
+                 ostream &warnings);
+void getReasoning(CompletionLP &lp, const Completion &completion, DVectorRational &dualmultipliers,
+                  DVectorRational &reducedcosts, DSVectorRational &reasoningRow);
+bool getVerifiedReasoning(CompletionLP &lp, const Completion &completion, bool farkas,
+                          DVectorRational &dualmultipliers, DVectorRational &reducedcosts,
+                          DSVectorRational &reasoningRow);
+bool printReasoningToCertificate(DSVectorRational &reasoningRow, ostream &output);
+const tuple<DSVectorPointer, Rational, int>* findConstraint(const CompletionLP &lp,
+                                                            const Completion &completion, long certIndex);
+bool rationalize(double value, Rational &result);
+bool verifyReasoning(const CompletionLP &lp, const Completion &completion,
+                     const DSVectorRational &reasoningRow);
+void runCompletion(CompletionLP &lp, Completion &completion);
+bool reportCompletion(const Completion &completion);
 
 static void processGlobalBoundChange(Rational rhs, Rational boundmult, int varindex,
                                        long boundindex, int sense)
@@ -152,6 +346,13 @@ void printUsage(const char* const argv[], int idx)
       \n                        turn off to boost performance if only weak derivations are present.\n"
       "  --debugmode=on/off    enable extra debug output from viprcomp\n"
       "  --verbosity=<level>   set verbosity level inside SoPlex\n"
+      "  --threads=<n>         complete incomplete derivations on n threads (0: all cores)\n"
+      "  --floatingpoint=on/off  complete from a floating-point solve if its rounded multipliers\
+      \n                        can be verified exactly, before solving exactly (default on)\n"
+      "  --reuse=on/off        reuse the multipliers of an equivalent completion after checking\
+      \n                        them exactly, instead of solving its LP again (default on)\n"
+      "  --compress=<type>     compression of the completed file: none, gzip or zstd;\
+      \n                        by default it is compressed like the input.\n"
       "\n";
    if(idx <= 0)
       cerr << "missing input file\n\n";
@@ -159,7 +360,7 @@ void printUsage(const char* const argv[], int idx)
       cerr << "invalid option \"" << argv[idx] << "\"\n\n";
 
    cerr << "usage: " << argv[0] << " " << "[options] <certificateFile>\n"
-             << "  <certificateFile>               .vipr file to be completed\n\n"
+             << "  <certificateFile>               .vipr file to be completed, may be gzip or zstd compressed\n\n"
              << usage;
 }
 
@@ -170,6 +371,8 @@ int main(int argc, char *argv[])
    int optidx;
    const char* certificateFileName;
    int verbosity = 0;
+   bool setCompression = false;
+   Compression compression = Compression::NONE;
 
    if( argc == 0 )
    {
@@ -264,6 +467,60 @@ int main(int argc, char *argv[])
                cout << "Continue with default setings (SoPlex on)" << endl;
             }
          }
+         // set whether completions try a floating-point solve first
+         else if(strncmp(option, "floatingpoint=", 14) == 0)
+         {
+            char* str = &option[14];
+            if( string(str) == "on")
+               floatingPointFirst = true;
+            else if( string(str) == "off")
+               floatingPointFirst = false;
+            else
+            {
+               cout << "Unknown input for floating-point completion (on/off expected). Read "
+               << string(str) << " instead" << endl;
+               cout << "Continue with default setings (floating-point completion on)" << endl;
+            }
+         }
+         // set whether completions reuse the multipliers of equivalent ones
+         else if(strncmp(option, "reuse=", 6) == 0)
+         {
+            char* str = &option[6];
+            if( string(str) == "on")
+               reuseCompletions = true;
+            else if( string(str) == "off")
+               reuseCompletions = false;
+            else
+            {
+               cout << "Unknown input for reusing completions (on/off expected). Read "
+               << string(str) << " instead" << endl;
+               cout << "Continue with default setings (reusing completions on)" << endl;
+            }
+         }
+         // set number of threads completing incomplete derivations
+         else if(strncmp(option, "threads=", 8) == 0)
+         {
+            if( !isdigit(option[8]) )
+            {
+               cerr << "Number of threads expected. Read " << &option[8] << " instead." << endl;
+               printUsage(argv, optidx);
+               return 1;
+            }
+            numberOfThreads = atoi(&option[8]);
+            if( numberOfThreads <= 0 )
+               numberOfThreads = max(1, int(thread::hardware_concurrency()));
+         }
+         // set compression of the completed file
+         else if(strncmp(option, "compress=", 9) == 0)
+         {
+            if( !parseCompression(&option[9], compression) )
+            {
+               cerr << "Unknown compression (none/gzip/zstd expected). Read " << &option[9] << " instead." << endl;
+               printUsage(argv, optidx);
+               return 1;
+            }
+            setCompression = true;
+         }
          else
          {
             printUsage(argv, optidx);
@@ -281,10 +538,16 @@ int main(int argc, char *argv[])
       return returnStatement;
    }
 
+   // file.vipr.gz becomes file_complete.vipr.gz
    string path = certificateFileName;
+   stripCompressionExtension(path);
    modifyFileName(path, "_complete.vipr");
 
-   completedFile.open( path.c_str(), ios::out );
+   if( !setCompression )
+      compression = certificateFile.compression();
+   path += compressionExtension(compression);
+
+   completedFile.open( path.c_str() );
 
    if( completedFile.fail() )
    {
@@ -321,6 +584,42 @@ int main(int argc, char *argv[])
 
                               cout << endl << "Completed in " << cpu_dur
                                    << " seconds (CPU)" << endl;
+
+                              if( numberOfCompletions > 0 )
+                              {
+                                 cout << "Completed " << numberOfCompletions
+                                      << " incomplete derivations in " << totalIterations
+                                      << " simplex iterations and " << completionTime
+                                      << " seconds, " << completionTime / numberOfCompletions
+                                      << " seconds per completion" << endl;
+                                 cout << "Warm started " << numberOfWarmStarts << " of them, "
+                                      << "removed " << totalRowsRemoved << " and added "
+                                      << totalRowsAdded << " LP rows" << endl;
+                                 cout << "Completed " << numberOfFarkasProofs
+                                      << " of them by a Farkas proof of an infeasible LP" << endl;
+                                 if( reuseCompletions )
+                                    cout << "Reused the multipliers of an equivalent completion for "
+                                         << numberOfCacheHits << " of them ("
+                                         << 100.0 * numberOfCacheHits / numberOfCompletions << "%), "
+                                         << numberOfCacheRejects << " reused multipliers failed the exact check"
+                                         << endl;
+                                 if( floatingPointFirst )
+                                 {
+                                    // estimated by the average exact solve of the others
+                                    double saved = (numberOfExactSolves > 0 ? numberOfFloatingPointCompletions
+                                       * exactTime / numberOfExactSolves - floatingPointTime : 0.0);
+
+                                    cout << "Verified " << numberOfFloatingPointCompletions << " of them ("
+                                         << 100.0 * numberOfFloatingPointCompletions / numberOfCompletions
+                                         << "%) from floating-point solves in " << floatingPointTime
+                                         << " seconds, " << numberOfExactSolves << " exact solves took "
+                                         << exactTime << " seconds";
+                                    if( numberOfExactSolves > 0 )
+                                       cout << ", estimated " << fabs(saved) << " seconds "
+                                            << (saved >= 0.0 ? "saved" : "lost");
+                                    cout << endl;
+                                 }
+                              }
                         }
    return returnStatement;
 }
@@ -446,8 +745,8 @@ bool processVAR(SoPlex &workinglp)
             if( usesoplex )
             {
                workinglp.addColRational( LPColRational( 1, dummycol, infinity, -infinity ) );
-               correspondingCertRow[{i, false}] = make_pair( -1, -1 );
-               originalCertRow[{i, false}] = make_pair( -1, -1);
+               correspondingCertCol.push_back( make_pair( -1, -1 ) );
+               originalCertCol.push_back( make_pair( -1, -1 ) );
                isInt[i] = false;
             }
             variables.push_back( tmp );
@@ -773,6 +1072,14 @@ bool processDER(SoPlex &workinglp)
       return true;
    }
 
+   // incomplete derivations are completed on the pool while the following ones are read; the
+   // output waits for at most a few completions per thread
+   CompletionPool pool(workinglp, numberOfThreads);
+   OrderedOutputBuf output(completedFile);
+   size_t maxPending = 4 * size_t(numberOfThreads);
+
+   if( numberOfThreads > 1 )
+      cout << "Completing incomplete derivations on " << numberOfThreads << " threads" << endl;
 
    for( long i = 0; i < numberOfDerivations; ++i )
    {
@@ -851,7 +1158,7 @@ bool processDER(SoPlex &workinglp)
          {
             printRowToCertificate(row, consense, rhs, label, isobjective);
             completedFile << " " + bracket + " " + kind;
-            returnStatement = derislin(workinglp, row, consense, rhs, label);
+            returnStatement = derislin(pool, output, row, consense, rhs, label);
             if( !returnStatement )
                cerr << "Could not process constraint " << label << endl;
          }
@@ -889,9 +1196,15 @@ bool processDER(SoPlex &workinglp)
          else
             certificateFile.ignore(numeric_limits<streamsize>::max(), '\n');
       }
+      if( returnStatement )
+         returnStatement = output.drain(pool, maxPending);
       if( !returnStatement )
          break;
    }
+
+   if( returnStatement )
+      returnStatement = output.drain(pool, 0);
+
    return returnStatement;
 }
 
@@ -994,7 +1307,8 @@ bool getConstraints(SoPlex &workinglp, string &consense, Rational &rhs, int &act
          returnStatement = false;
 
       lastrow = workinglp.numRows();
-      correspondingCertRow[{lastrow-1, true}] = make_pair(activeConstraint, activeConstraint);
+      correspondingCertRow.resize(lastrow);
+      correspondingCertRow[lastrow-1] = make_pair(activeConstraint, activeConstraint);
    }
    else
    {
@@ -1078,8 +1392,8 @@ TERMINATE:
 
 
 // Reads linear combinations for completing weak domination
-static bool readLinComb( int &sense, Rational &rhs, SVectorRat& coefficients, SVectorRat& mult,
-                  int currentConstraintIndex, SVectorBool &assumptionList)
+static bool readLinComb( int &sense, Rational &rhs, DenseAccumulator<Rational>& coefficients,
+                  SVectorRat& mult, int currentConstraintIndex, SVectorBool &assumptionList)
 {
    bool returnStatement = true;
 
@@ -1091,6 +1405,8 @@ static bool readLinComb( int &sense, Rational &rhs, SVectorRat& coefficients, SV
    {
       rhs = 0;
       coefficients.clear();
+      if( coefficients.dimension() != size_t(numberOfVariables) )
+         coefficients.resize(numberOfVariables);
       assumptionList.clear();
 
       for( auto it = mult.begin(); it != mult.end(); ++it )
@@ -1109,11 +1425,13 @@ static bool readLinComb( int &sense, Rational &rhs, SVectorRat& coefficients, SV
 
          for( auto i = 0; i < c->size(); ++i )
          {
-            (coefficients)[c->index(i)] += a * (*c)[c->index(i)];
+            coefficients.addProduct(c->index(i), a, c->value(i));
          }
 
          rhs += a * get<1>(con);
       }
+
+      coefficients.sortTouched();
    }
 
    return returnStatement;
@@ -1122,7 +1440,7 @@ static bool readLinComb( int &sense, Rational &rhs, SVectorRat& coefficients, SV
 // Complete "lin"-type derivations marked "weak"
 static bool completeWeakDomination(DSVectorPointer row, string &consense, Rational &rhs)
 {
-   SVectorRat coefDer;
+   static DenseAccumulator<Rational> coefDer; // reused across derivations
    SVectorRat multDer;
    Rational rhsDer;
    Rational correctedSide;
@@ -1186,13 +1504,13 @@ static bool completeWeakDomination(DSVectorPointer row, string &consense, Ration
 
    correctedSide = rhsDer;
 
-   for( auto it = coefDer.begin() ; it != coefDer.end() ; ++it )
+   for( size_t k = 0; k < coefDer.numberOfTouched(); ++k )
    {
-      int idx = it->first;
-      Rational derivedVal = it->second;
+      int idx = coefDer.touched(k);
+      Rational derivedVal = coefDer[idx];
       Rational valToDerive = (*row)[idx];
 
-      coefDer[idx] = valToDerive;
+      coefDer.ref(idx) = valToDerive;
 
       if( derivedVal == valToDerive )
          continue;
@@ -1380,25 +1698,23 @@ static bool completeWeakDomination(DSVectorPointer row, string &consense, Ration
 
 // Case derivation is "lin"
 // Completes cases "incomplete" or "weak"
-bool derislin(SoPlex &workinglp, DSVectorPointer row, string &consense, Rational &rhs, string &label)
+bool derislin(CompletionPool &pool, OrderedOutputBuf &output, DSVectorPointer row, string &consense,
+              Rational &rhs, string &label)
 {
 
    string numberOfCoefficients, tmp, bracket;
    long intOfCoefficients, idx, derhir;
 
-   vector<long> newActiveDerivations;
-   vector<long> toDeleteDerivations;
-   vector<long> toAddDerivations;
-
    Rational val;
    DSVectorRational reasoningRow(0);
 
    certificateFile >> numberOfCoefficients;
 
-   // Prepares completion of "incomplete" reasoning by locally modifying the LP
+   // Prepares completion of "incomplete" reasoning, which is solved by the pool and written to
+   // the completed file in order
    if( numberOfCoefficients == "incomplete" )
    {
-      VectorRational newObjective(0);
+      shared_ptr<Completion> completion(make_shared<Completion>());
 
       assert(usesoplex);
 
@@ -1407,42 +1723,48 @@ bool derislin(SoPlex &workinglp, DSVectorPointer row, string &consense, Rational
          cerr << "soplex support must be enabled to process incomplete constraint type. rerun with parameter usesoplex=ON." << endl;
          return false;
       }
-      newObjective.reSize(numberOfVariables);
-      newObjective.reDim(numberOfVariables);
-      newObjective = *row;
-      workinglp.changeObjRational(newObjective);
+      completion->label = label;
+      completion->objective = row;
+      completion->rhs = rhs;
 
       if( consense == "G" or consense == "E" )
-         workinglp.setIntParam(SoPlex::OBJSENSE, SoPlex::OBJSENSE_MINIMIZE);
+      {
+         completion->objSense = SoPlex::OBJSENSE_MINIMIZE;
+         completion->sense = (consense == "E" ? 0 : 1);
+      }
       else if( consense == "L")
-         workinglp.setIntParam(SoPlex::OBJSENSE, SoPlex::OBJSENSE_MAXIMIZE);
+      {
+         completion->objSense = SoPlex::OBJSENSE_MAXIMIZE;
+         completion->sense = -1;
+      }
       else
+      {
          cerr << "Invalid sense: " << consense << endl;
+         completion->objSense = SoPlex::OBJSENSE_MINIMIZE;
+         completion->sense = 1;
+      }
 
       certificateFile >> tmp;
 
       while( tmp != "}" )
       {
-         newActiveDerivations.push_back(stol(tmp));
+         completion->active.push_back(stol(tmp));
 
          certificateFile >> tmp;
       }
 
-      sort(currentlyActiveDerivations.begin(), currentlyActiveDerivations.end(), less<int>());
-      sort(newActiveDerivations.begin(), newActiveDerivations.end(), less<int>());
+      sort(completion->active.begin(), completion->active.end(), less<long>());
 
-      set_difference( currentlyActiveDerivations.begin(), currentlyActiveDerivations.end(),
-                        newActiveDerivations.begin(), newActiveDerivations.end(),
-                        inserter( toDeleteDerivations, toDeleteDerivations.begin() ) );
+      for( auto index : completion->active )
+         completion->activeConstraints.push_back(constraints[index]);
 
-      set_difference( newActiveDerivations.begin(), newActiveDerivations.end(),
-                        currentlyActiveDerivations.begin(), currentlyActiveDerivations.end(),
-                        inserter( toAddDerivations, toAddDerivations.begin() ) );
+      certificateFile >> completion->derHierarchy;
 
-      toDeleteDerivations = currentlyActiveDerivations;
-      toAddDerivations = newActiveDerivations;
-      currentlyActiveDerivations = newActiveDerivations;
-      return completeLin(workinglp, toDeleteDerivations, toAddDerivations, label);
+      if( reuseCompletions )
+         completion->equivalent = completionCache.findOrInsert(completion);
+      output.append(completion);
+      pool.submit(completion);
+      return true;
    }
 
    else if( numberOfCoefficients == "weak")
@@ -1558,18 +1880,19 @@ bool derissol()
    }
 }
 
-// Completes "incomplete" derivations
-// Locally modifies LP and solves
-bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &derToAdd, string &label)
+// Completes an "incomplete" derivation
+// Locally modifies a copy of the LP to the active derivations of the completion and solves it
+bool completeLin(CompletionLP &lp, Completion &completion, ostream &output, ostream &messages,
+   ostream &warnings)
 {
-   string tmp;
-   long numrows, derHierarchy;
+   SoPlex &workinglp = lp.lp;
    DSVectorPointer row(make_shared<DSVectorRational>());
    int consense, normalizedSense;
    Rational rhs;
    lpIndex lpData;
    Rational normalizedRhs;
-   vector<long> rowsToDelete;
+   vector<long> derToDelete;
+   vector<long> derToAdd;
 
    assert(usesoplex);
 
@@ -1577,42 +1900,125 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
    DVectorRational reducedcosts(0);
 
    vector<long>::iterator derIterator;
+   auto start = chrono::steady_clock::now();
+   vector<int> perm;
+   DSVectorRational reasoningRow(0);
+
+   // An equivalent LP was completed before, its multipliers only need to be checked against the
+   // side of this derivation
+   if( completion.equivalent && completion.equivalent->solved )
+   {
+      reasoningRow = completion.equivalent->reasoningRow;
+
+      if( verifyReasoning(lp, completion, reasoningRow) )
+      {
+         chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+         completion.cacheHit = true;
+         completion.farkas = completion.equivalent->farkas;
+         completion.seconds = duration.count();
+
+         if( debugmode == true )
+            messages << "completed " << completion.label << " with the multipliers of an equivalent completion" << endl;
+
+         printReasoningToCertificate(reasoningRow, output);
+         output << " }";
+         output << " " << completion.derHierarchy;
+         return true;
+      }
+
+      completion.cacheReject = true;
+      reasoningRow.clear();
+   }
+
+   set_difference( lp.active.begin(), lp.active.end(),
+                     completion.active.begin(), completion.active.end(),
+                     back_inserter( derToDelete ) );
 
-   // Delete rows and reset bounds from LP which are not used in the current completion attempt
+   set_difference( completion.active.begin(), completion.active.end(),
+                     lp.active.begin(), lp.active.end(),
+                     back_inserter( derToAdd ) );
+
+   VectorRational newObjective(0);
+
+   newObjective.reSize(numberOfVariables);
+   newObjective.reDim(numberOfVariables);
+   newObjective = *completion.objective;
+   workinglp.changeObjRational(newObjective);
+   workinglp.setIntParam(SoPlex::OBJSENSE, completion.objSense);
+
+   // Delete rows and reset bounds from LP which are not used in the current completion attempt.
+   // Only the rows of derivations that are no longer active are removed, the others stay in
+   // the LP together with their basis status
    for( derIterator = derToDelete.begin(); derIterator != derToDelete.end(); derIterator++)
    {
-      lpData = correspondingLpData[*derIterator];
+      lpData = lp.lpData[lower_bound(lp.active.begin(), lp.active.end(), *derIterator) - lp.active.begin()];
+
+      if( lpData.idx < 0 )
+         continue;
 
       if( lpData.isRowId == true)
       {
+         if( perm.empty() )
+            perm.resize(workinglp.numRowsRational(), 0);
 
-         rowsToDelete.push_back(lpData.idx);
-         correspondingCertRow.erase({lpData.idx, true});
-         correspondingLpData.erase(*derIterator);
+         perm[lpData.idx] = -1;
       }
       else
       {
-         Rational originalUpperBound = get<0>(upperBounds[lpData.idx]);
-         Rational originalLowerBound = get<0>(lowerBounds[lpData.idx]);
-
          workinglp.changeUpperRational( lpData.idx, infinity );
          workinglp.changeLowerRational( lpData.idx, -infinity );
 
-         correspondingCertRow[{lpData.idx, false}] = originalCertRow[{lpData.idx, false}];
-         correspondingLpData.erase(*derIterator);
+         lp.certCol[lpData.idx] = originalCertCol[lpData.idx];
       }
    }
 
-   sort(rowsToDelete.begin(), rowsToDelete.end(), greater<int>());
-   for( auto rowToDelete = rowsToDelete.begin(); rowToDelete != rowsToDelete.end(); rowToDelete++ )
+   // SoPlex moves rows behind removed ones to the freed positions and returns the new index of
+   // every row in perm, so the rows of active derivations are renumbered accordingly
+   if( !perm.empty() )
    {
-      workinglp.removeRowRational(*rowToDelete);
+      vector<certIndices> certRow;
+
+      workinglp.removeRowsRational(perm.data());
+      certRow.resize(workinglp.numRowsRational());
+
+      for( long i = 0; i < long(perm.size()); ++i )
+      {
+         if( perm[i] < 0 )
+            ++completion.rowsRemoved;
+         else
+            certRow[perm[i]] = lp.certRow[i];
+      }
+
+      lp.certRow.swap(certRow);
+
+      for( auto &entry : lp.lpData )
+      {
+         if( entry.isRowId && entry.idx >= 0 && entry.idx < long(perm.size()) )
+            entry.idx = perm[entry.idx];
+      }
    }
 
+   // derivations that stay active keep their rows, the added ones get theirs below
+   vector<lpIndex> activeLpData(completion.active.size(), lpIndex{-1, true});
+
+   for( size_t k = 0, j = 0; k < lp.active.size(); ++k )
+   {
+      while( j < completion.active.size() && completion.active[j] < lp.active[k] )
+         ++j;
+      if( j < completion.active.size() && completion.active[j] == lp.active[k] )
+         activeLpData[j] = lp.lpData[k];
+   }
+
+   lp.active = completion.active;
+   lp.lpData.swap(activeLpData);
+
    // Update LP with new derivations to be used
    for( derIterator = derToAdd.begin(); derIterator != derToAdd.end(); derIterator++ )
    {
-      auto &missingCon = constraints[*derIterator];
+      long activeIndex = lower_bound(completion.active.begin(), completion.active.end(), *derIterator)
+         - completion.active.begin();
+      auto &missingCon = completion.activeConstraints[activeIndex];
       auto ncurrent = workinglp.numRowsRational();
       row = get<0>(missingCon);
       consense = get<2>(missingCon);
@@ -1642,21 +2048,21 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
                if( workinglp.lowerRational(row->index(0)) > normalizedRhs )
                {
                   workinglp.addRowRational( LPRowRational( -infinity, *row, rhs ) );
-                  correspondingCertRow[{ workinglp.numRows()-1, true }] = make_pair( *derIterator, *derIterator );
-                  correspondingLpData[*derIterator] = {workinglp.numRows()-1 , true};
+                  lp.certRow.push_back( make_pair( *derIterator, *derIterator ) );
+                  lp.lpData[activeIndex] = {workinglp.numRows()-1 , true};
                   assert(ncurrent + 1 == workinglp.numRowsRational());
                }
 
                else
                {
                   workinglp.changeUpperRational( row->index(0), normalizedRhs );
-                  correspondingCertRow[{ row->index(0), false }] = make_pair( *derIterator, *derIterator );
-                  correspondingLpData[*derIterator] = {row->index(0), false};
+                  lp.certCol[row->index(0)] = make_pair( *derIterator, *derIterator );
+                  lp.lpData[activeIndex] = {row->index(0), false};
                }
             }
             else
             {
-               cerr << "Error: in derivation " << label << ". New bound is no improvement.\n";
+               warnings << "Error: in derivation " << completion.label << ". New bound is no improvement.\n";
                return false;
             }
 
@@ -1665,20 +2071,20 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
                if( workinglp.upperRational(row->index(0)) < normalizedRhs )
                {
                   workinglp.addRowRational( LPRowRational( rhs, *row, infinity ) );
-                  correspondingCertRow[{ workinglp.numRows()-1, true }] = make_pair( *derIterator, *derIterator );
-                  correspondingLpData[*derIterator] = {workinglp.numRows()-1 , true};
+                  lp.certRow.push_back( make_pair( *derIterator, *derIterator ) );
+                  lp.lpData[activeIndex] = {workinglp.numRows()-1 , true};
                   assert(ncurrent + 1 == workinglp.numRowsRational());
                }
                else
                {
                   workinglp.changeLowerRational( row->index(0), normalizedRhs );
-                  correspondingCertRow[{ row->index(0), false }] = make_pair( *derIterator, *derIterator );
-                  correspondingLpData[*derIterator] = {row->index(0), false};
+                  lp.certCol[row->index(0)] = make_pair( *derIterator, *derIterator );
+                  lp.lpData[activeIndex] = {row->index(0), false};
                }
             }
             else
             {
-               cerr << "Error: in derivation " << label << ". New bound is no improvement.\n";
+               warnings << "Error: in derivation " << completion.label << ". New bound is no improvement.\n";
                return false;
             }
          }
@@ -1690,16 +2096,16 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
             if( workinglp.lowerRational(row->index(0)) > normalizedRhs )
             {
                workinglp.addRowRational( LPRowRational( -infinity, *row, rhs ) );
-               correspondingCertRow[{ workinglp.numRows()-1, true }] = make_pair( *derIterator, *derIterator );
-               correspondingLpData[*derIterator] = {workinglp.numRows()-1 , true};
+               lp.certRow.push_back( make_pair( *derIterator, *derIterator ) );
+               lp.lpData[activeIndex] = {workinglp.numRows()-1 , true};
                assert(ncurrent + 1 == workinglp.numRowsRational());
             }
 
             else
             {
                workinglp.changeUpperRational( row->index(0), normalizedRhs );
-               correspondingCertRow[{ row->index(0), false }] = make_pair( *derIterator, *derIterator );
-               correspondingLpData[*derIterator] = {row->index(0), false};
+               lp.certCol[row->index(0)] = make_pair( *derIterator, *derIterator );
+               lp.lpData[activeIndex] = {row->index(0), false};
             }
          }
 
@@ -1709,20 +2115,20 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
             if( workinglp.upperRational(row->index(0)) < normalizedRhs )
             {
                workinglp.addRowRational( LPRowRational( rhs, *row, infinity ) );
-               correspondingCertRow[{ workinglp.numRows()-1, true }] = make_pair( *derIterator, *derIterator );
-               correspondingLpData[*derIterator] = {workinglp.numRows()-1 , true};
+               lp.certRow.push_back( make_pair( *derIterator, *derIterator ) );
+               lp.lpData[activeIndex] = {workinglp.numRows()-1 , true};
                assert(ncurrent + 1 == workinglp.numRowsRational());
             }
             else
             {
                workinglp.changeLowerRational( row->index(0), normalizedRhs );
-               correspondingCertRow[{ row->index(0), false }] = make_pair( *derIterator, *derIterator );
-               correspondingLpData[*derIterator] = {row->index(0), false};
+               lp.certCol[row->index(0)] = make_pair( *derIterator, *derIterator );
+               lp.lpData[activeIndex] = {row->index(0), false};
             }
          }
          else
          {
-            cerr << "Error: in derivation " << label << ". New bound is no improvement.";
+            warnings << "Error: in derivation " << completion.label << ". New bound is no improvement.";
             return false;
          }
       }
@@ -1736,90 +2142,628 @@ bool completeLin(SoPlex &workinglp, vector<long> &derToDelete, vector<long> &der
          else
             return false;
 
-         correspondingCertRow[{ workinglp.numRows()-1, true }] = make_pair( *derIterator, *derIterator );
-         correspondingLpData[*derIterator] = {workinglp.numRows()-1 , true};
+         lp.certRow.push_back( make_pair( *derIterator, *derIterator ) );
+         lp.lpData[activeIndex] = {workinglp.numRows()-1 , true};
          assert(ncurrent + 1 == workinglp.numRowsRational());
+         ++completion.rowsAdded;
       }
    }
 
+   // after removing and adding rows, every active derivation still finds its own row
+   assert(long(lp.certRow.size()) == workinglp.numRowsRational());
+   for( size_t k = 0; k < lp.active.size(); ++k )
+      assert(!lp.lpData[k].isRowId || lp.lpData[k].idx < 0 || lp.certRow[lp.lpData[k].idx].first == lp.active[k]);
 
-
-   SPxSolver::Status stat;
-   numrows = workinglp.numRows();
+   SPxSolver::Status stat = SPxSolver::UNKNOWN;
+   long numrows = workinglp.numRows();
    dualmultipliers.reDim(numrows);
    reducedcosts.reDim(numberOfVariables);
 
-   stat = workinglp.optimize();
+   completion.warmStart = workinglp.hasBasis();
 
-   if( stat == SPxSolver::OPTIMAL )
+   // Solve in floating point first and keep the rounded multipliers if they derive the
+   // constraint exactly; the exact solve then starts from the basis found
+   if( floatingPointFirst )
    {
-      workinglp.getDualRational(dualmultipliers);
-      workinglp.getRedCostRational(reducedcosts);
+      auto floatingPointStart = chrono::steady_clock::now();
 
-      printReasoningToCertificate(dualmultipliers, reducedcosts);
-      completedFile << " }";
-      certificateFile >> derHierarchy;
-      completedFile << " " << derHierarchy;
+      workinglp.setIntParam(SoPlex::SOLVEMODE, SoPlex::SOLVEMODE_REAL);
+      workinglp.setRealParam(SoPlex::FEASTOL, FLOATING_POINT_TOLERANCE);
+      workinglp.setRealParam(SoPlex::OPTTOL, FLOATING_POINT_TOLERANCE);
 
+      stat = workinglp.optimize();
+      completion.iterations += workinglp.numIterations();
+
+      if( stat == SPxSolver::OPTIMAL || stat == SPxSolver::INFEASIBLE )
+      {
+         DVectorReal dualReal(numrows);
+         bool rationalized = (stat == SPxSolver::OPTIMAL ? workinglp.getDualReal(dualReal)
+            : workinglp.getDualFarkasReal(dualReal));
+
+         for( long i = 0; i < numrows && rationalized; ++i )
+            rationalized = rationalize(dualReal[i], dualmultipliers[i]);
+
+         // the columns are free, so the reduced costs of an exact solution are zero
+         DVectorRational zeroReducedCosts(0);
+
+         if( rationalized )
+            completion.floatingPoint = getVerifiedReasoning(lp, completion, stat == SPxSolver::INFEASIBLE,
+               dualmultipliers, zeroReducedCosts, reasoningRow);
+      }
+
+      workinglp.setIntParam(SoPlex::SOLVEMODE, SoPlex::SOLVEMODE_RATIONAL);
+      workinglp.setRealParam(SoPlex::FEASTOL, 0.0);
+      workinglp.setRealParam(SoPlex::OPTTOL, 0.0);
+
+      chrono::duration<double> floatingPointDuration = chrono::steady_clock::now() - floatingPointStart;
+      completion.floatingPointSeconds = floatingPointDuration.count();
    }
-   else if( stat == SPxSolver::INFEASIBLE )
+
+   bool verified = completion.floatingPoint;
+
+   if( !completion.floatingPoint )
    {
-      workinglp.getDualFarkasRational(dualmultipliers);
-      workinglp.getRedCostRational(reducedcosts);
+      auto exactStart = chrono::steady_clock::now();
 
-      printReasoningToCertificate(dualmultipliers, reducedcosts);
-      completedFile << "}";
-      certificateFile >> derHierarchy;
-      completedFile << " " << derHierarchy;
+      completion.exactSolve = true;
+      stat = workinglp.optimize();
+      completion.iterations += workinglp.numIterations();
+
+      if( stat == SPxSolver::OPTIMAL || stat == SPxSolver::INFEASIBLE )
+      {
+         // a Farkas proof has no reduced costs, the free columns contribute nothing to it
+         if( stat == SPxSolver::OPTIMAL )
+         {
+            workinglp.getDualRational(dualmultipliers);
+            workinglp.getRedCostRational(reducedcosts);
+         }
+         else
+            workinglp.getDualFarkasRational(dualmultipliers);
 
+         // an exact solution derives the constraint unless the rows of the LP do not match the
+         // active derivations, so it is checked like a floating-point one before it is written
+         verified = getVerifiedReasoning(lp, completion, stat == SPxSolver::INFEASIBLE,
+            dualmultipliers, reducedcosts, reasoningRow);
+      }
+
+      chrono::duration<double> exactDuration = chrono::steady_clock::now() - exactStart;
+      completion.exactSeconds = exactDuration.count();
+   }
+
+   chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+   completion.seconds = duration.count();
+
+   if( debugmode == true )
+   {
+      messages << "completed " << completion.label << " in " << completion.iterations << " iterations, "
+               << completion.seconds << " seconds (" << (completion.warmStart ? "warm" : "cold")
+               << " start, " << (completion.floatingPoint ? "floating-point" : "exact")
+               << (stat == SPxSolver::INFEASIBLE ? " Farkas proof, " : " solution, ")
+               << derToDelete.size() << " derivations removed, " << derToAdd.size()
+               << " added)" << endl;
+   }
+
+   if( (stat == SPxSolver::OPTIMAL || stat == SPxSolver::INFEASIBLE) && verified )
+   {
+      printReasoningToCertificate(reasoningRow, output);
+      output << " }";
+      output << " " << completion.derHierarchy;
+
+      completion.solved = true;
+      completion.farkas = (stat == SPxSolver::INFEASIBLE);
+      completion.reasoningRow = reasoningRow;
    }
    else
    {
-      cerr << "Warning: Completion attempt of Derivation "<< label <<" returned with status " << stat << ".\n";
-      cerr << "Skip and continue completion of certificate.\n";
-      completedFile << " incomplete";
-      for( auto i: currentlyActiveDerivations )
-         completedFile << " " << i;
+      if( stat == SPxSolver::OPTIMAL || stat == SPxSolver::INFEASIBLE )
+         warnings << "Warning: Multipliers of Derivation " << completion.label << " do not derive it exactly.\n";
+      else
+         warnings << "Warning: Completion attempt of Derivation "<< completion.label <<" returned with status " << stat << ".\n";
+      warnings << "Skip and continue completion of certificate.\n";
+      output << " incomplete";
+      for( auto i: completion.active )
+         output << " " << i;
 
    }
    return true;
 }
 
-bool printReasoningToCertificate(DVectorRational &dualmultipliers, DVectorRational &reducedcosts)
+// Translates the nonzero dual multipliers and reduced costs of the LP into multipliers of the
+// certificate constraints
+void getReasoning(CompletionLP &lp, const Completion &completion, DVectorRational &dualmultipliers,
+   DVectorRational &reducedcosts, DSVectorRational &reasoningRow)
 {
-   DSVectorRational reasoningRow(0);
    long certIndex;
    Rational correctionFactor;
 
    for( int i= 0; i < reducedcosts.dim(); ++i )
    {
-      if( sign(reducedcosts[i]) < 0 )
-         certIndex = correspondingCertRow[{i, false}].second;
+      int redcostSign = sign(reducedcosts[i]);
+
+      if( redcostSign == 0 )
+         continue;
+
+      if( redcostSign < 0 )
+         certIndex = lp.certCol[i].second;
       else
-         certIndex = correspondingCertRow[{i, false}].first;
+         certIndex = lp.certCol[i].first;
 
       reasoningRow.add(certIndex, reducedcosts[i] );
    }
 
    for( int i = 0; i < dualmultipliers.dim(); ++i )
    {
+      if( sign(dualmultipliers[i]) == 0 )
+         continue;
+
+      certIndex = lp.certRow[i].first;
 
-      certIndex = correspondingCertRow[{i, true}].first;
-      if( get<0>(constraints[certIndex])->dim() == 1 )
-         correctionFactor = get<0>(constraints[certIndex])->value(0);
+      const DSVectorPointer &row = get<0>(*findConstraint(lp, completion, certIndex));
+
+      if( row->dim() == 1 )
+         correctionFactor = row->value(0);
       else
          correctionFactor = 1;
 
       reasoningRow.add(certIndex, dualmultipliers[i] * correctionFactor);
 
    }
-   completedFile << " " << reasoningRow.size();
+}
+
+// Translates the multipliers of a solve like getReasoning and checks them exactly; true if they
+// derive the constraint.  The sign of a Farkas proof depends on the objective sense, so a Farkas
+// proof that fails the check is checked again with the opposite sign
+bool getVerifiedReasoning(CompletionLP &lp, const Completion &completion, bool farkas,
+   DVectorRational &dualmultipliers, DVectorRational &reducedcosts, DSVectorRational &reasoningRow)
+{
+   reasoningRow.clear();
+   getReasoning(lp, completion, dualmultipliers, reducedcosts, reasoningRow);
+
+   if( verifyReasoning(lp, completion, reasoningRow) )
+      return true;
+
+   if( !farkas )
+      return false;
+
+   for( int i = 0; i < dualmultipliers.dim(); ++i )
+      dualmultipliers[i] = -dualmultipliers[i];
+
+   reasoningRow.clear();
+   getReasoning(lp, completion, dualmultipliers, reducedcosts, reasoningRow);
+
+   return verifyReasoning(lp, completion, reasoningRow);
+}
+
+bool printReasoningToCertificate(DSVectorRational &reasoningRow, ostream &output)
+{
+   output << " " << reasoningRow.size();
    reasoningRow.sort();
 
    for( size_t i = 0; i < reasoningRow.size(); i++ )
       {
-         completedFile << " " << reasoningRow.index(i) << " " << reasoningRow[reasoningRow.index(i)];
+         output << " " << reasoningRow.index(i) << " " << reasoningRow.value(i);
+      }
+
+   return true;
+}
+
+// Returns the constraint of the CON section or active derivation with the given index, nullptr
+// if the completion cannot use it
+const tuple<DSVectorPointer, Rational, int>* findConstraint(const CompletionLP &lp,
+   const Completion &completion, long certIndex)
+{
+   if( certIndex < 0 )
+      return nullptr;
+
+   if( certIndex < long(lp.conConstraints->size()) )
+      return &(*lp.conConstraints)[certIndex];
+
+   auto it = lower_bound(completion.active.begin(), completion.active.end(), certIndex);
+
+   if( it == completion.active.end() || *it != certIndex )
+      return nullptr;
+
+   return &completion.activeConstraints[it - completion.active.begin()];
+}
+
+// Approximates value by the continued fraction with the largest denominator of at most
+// MAX_RATIONALIZE_DENOMINATOR; false if that is not within FLOATING_POINT_TOLERANCE
+bool rationalize(double value, Rational &result)
+{
+   double x = fabs(value);
+   double rest = x;
+   long p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+
+   if( x <= FLOATING_POINT_TOLERANCE )
+   {
+      result = 0;
+      return true;
+   }
+
+   // also rejects nan and infinity; numerators stay below 2^63
+   if( !(x < 1e9) )
+      return false;
+
+   for( int k = 0; k < 64; ++k )
+   {
+      double a = floor(rest);
+      long p2 = long(a) * p1 + p0;
+      long q2 = long(a) * q1 + q0;
+
+      if( q2 > MAX_RATIONALIZE_DENOMINATOR )
+         break;
+
+      p0 = p1;
+      q0 = q1;
+      p1 = p2;
+      q1 = q2;
+
+      if( fabs(x - double(p1) / double(q1)) <= FLOATING_POINT_TOLERANCE * max(1.0, x) )
+      {
+         result = Rational(value < 0 ? -p1 : p1) / Rational(q1);
+         return true;
       }
 
+      if( rest - a <= 0.0 )
+         break;
+      rest = 1.0 / (rest - a);
+   }
+
+   return false;
+}
+
+// Checks exactly that the multipliers of a completion derive its constraint: the signs must
+// match the senses of the combined constraints, and the combination must either have the
+// coefficients of the derived constraint and a dominating side or be a contradiction.  Like
+// the weak domination check, the combination is summed in rational arithmetic
+bool verifyReasoning(const CompletionLP &lp, const Completion &completion,
+   const DSVectorRational &reasoningRow)
+{
+   thread_local DenseAccumulator<Rational> coefficients;
+   Rational rhs = 0;
+   int sense = 0;
+   size_t nonzeros = 0;
+
+   coefficients.clear();
+   if( coefficients.dimension() != size_t(numberOfVariables) )
+      coefficients.resize(numberOfVariables);
+
+   for( int i = 0; i < reasoningRow.size(); ++i )
+   {
+      const Rational &a = reasoningRow.value(i);
+
+      if( a == 0 )
+         continue;
+
+      auto con = findConstraint(lp, completion, reasoningRow.index(i));
+
+      if( con == nullptr )
+         return false;
+
+      int tmp = get<2>(*con) * a.sign();
+
+      if( tmp != 0 && sense != 0 && tmp != sense )
+         return false;
+      if( tmp != 0 )
+         sense = tmp;
+
+      const DSVectorPointer &row = get<0>(*con);
+
+      for( int j = 0; j < row->size(); ++j )
+         coefficients.addProduct(row->index(j), a, row->value(j));
+
+      rhs += a * get<1>(*con);
+   }
+
+   for( size_t k = 0; k < coefficients.numberOfTouched(); ++k )
+      nonzeros += (coefficients[coefficients.touched(k)] != 0 ? 1 : 0);
+
+   // 0 >= rhs > 0, 0 <= rhs < 0 or 0 = rhs != 0
+   if( nonzeros == 0 && (sense == 0 ? rhs != 0 : sense * rhs.sign() > 0) )
+      return true;
+
+   const DSVectorRational &objective = *completion.objective;
+   size_t objectiveNonzeros = 0;
+
+   for( int j = 0; j < objective.size(); ++j )
+   {
+      if( objective.value(j) == 0 )
+         continue;
+      if( size_t(objective.index(j)) >= coefficients.dimension()
+         || coefficients[objective.index(j)] != objective.value(j) )
+         return false;
+      ++objectiveNonzeros;
+   }
+
+   if( nonzeros != objectiveNonzeros )
+      return false;
+
+   if( completion.sense == 0 )
+      return sense == 0 && rhs == completion.rhs;
+
+   return (sense == 0 || sense == completion.sense)
+      && (completion.sense > 0 ? rhs >= completion.rhs : rhs <= completion.rhs);
+}
+
+
+// Completes a derivation on a copy of the LP and publishes the result
+void runCompletion(CompletionLP &lp, Completion &completion)
+{
+   ostringstream output;
+   ostringstream messages;
+   ostringstream warnings;
+
+   completion.success = completeLin(lp, completion, output, messages, warnings);
+   completion.equivalent.reset();
+   completion.output = output.str();
+   completion.messages = messages.str();
+   completion.warnings = warnings.str();
+}
+
+
+// Prints the messages of a completion and adds it to the statistics
+bool reportCompletion(const Completion &completion)
+{
+   cout << completion.messages;
+   cerr << completion.warnings;
+
+   ++numberOfCompletions;
+   numberOfWarmStarts += (completion.warmStart ? 1 : 0);
+   totalIterations += completion.iterations;
+   totalRowsRemoved += completion.rowsRemoved;
+   totalRowsAdded += completion.rowsAdded;
+   completionTime += completion.seconds;
+   numberOfFloatingPointCompletions += (completion.floatingPoint ? 1 : 0);
+   numberOfExactSolves += (completion.exactSolve ? 1 : 0);
+   floatingPointTime += completion.floatingPointSeconds;
+   exactTime += completion.exactSeconds;
+   numberOfCacheHits += (completion.cacheHit ? 1 : 0);
+   numberOfCacheRejects += (completion.cacheReject ? 1 : 0);
+   numberOfFarkasProofs += (completion.farkas ? 1 : 0);
+
+   if( !completion.success )
+      cerr << "Could not process constraint " << completion.label << endl;
+
+   return completion.success;
+}
+
+
+// CompletionPool methods
+CompletionPool::~CompletionPool()
+{
+   {
+      lock_guard<mutex> lock(_mutex);
+      _stop = true;
+   }
+   _hasWork.notify_all();
+   _isDone.notify_all();
+
+   for( auto &worker : _workers )
+      worker.join();
+}
+
+
+void CompletionPool::_start()
+{
+   _conConstraints.assign(constraints.begin(), constraints.begin() + numberOfConstraints);
+
+   for( int i = 0; i < _numberOfThreads; ++i )
+   {
+      _lps.emplace_back(new CompletionLP(_baselp));
+      _lps.back()->conConstraints = &_conConstraints;
+   }
+
+   if( _numberOfThreads > 1 )
+   {
+      _queues.resize(_lps.size());
+
+      for( size_t i = 0; i < _lps.size(); ++i )
+         _workers.emplace_back(&CompletionPool::_work, this, i);
+   }
+}
+
+
+void CompletionPool::submit(const shared_ptr<Completion> &completion)
+{
+   if( _lps.empty() )
+      _start();
+
+   if( _workers.empty() )
+   {
+      runCompletion(*_lps[0], *completion);
+      completion->done = true;
+      return;
+   }
+
+   {
+      lock_guard<mutex> lock(_mutex);
+      _queues[_next].push_back(completion);
+      _next = (_next + 1) % _queues.size();
+   }
+   _hasWork.notify_all();
+}
+
+
+void CompletionPool::wait(const Completion &completion)
+{
+   unique_lock<mutex> lock(_mutex);
+
+   _isDone.wait(lock, [this, &completion] { return _stop || completion.done.load(); });
+}
+
+
+void CompletionPool::_work(size_t index)
+{
+   auto &queue = _queues[index];
+
+   for( ;; )
+   {
+      shared_ptr<Completion> completion;
+      {
+         unique_lock<mutex> lock(_mutex);
+
+         _hasWork.wait(lock, [this, &queue] { return _stop || !queue.empty(); });
+         if( _stop )
+            return;
+
+         completion = queue.front();
+         queue.pop_front();
+      }
+
+      // the equivalent completion was submitted earlier, so it is done or ahead in its queue,
+      // unless the pool stops before its copy gets to it
+      if( completion->equivalent )
+      {
+         wait(*completion->equivalent);
+         if( !completion->equivalent->done )
+            return;
+      }
+
+      runCompletion(*_lps[index], *completion);
+
+      {
+         lock_guard<mutex> lock(_mutex);
+         completion->done = true;
+      }
+      _isDone.notify_all();
+   }
+}
+
+
+// OrderedOutputBuf methods
+int OrderedOutputBuf::overflow(int c)
+{
+   if( c != traits_type::eof() )
+      _segments.back().text.push_back(char(c));
+
+   return traits_type::not_eof(c);
+}
+
+
+streamsize OrderedOutputBuf::xsputn(const char* s, streamsize n)
+{
+   _segments.back().text.append(s, size_t(n));
+   return n;
+}
+
+
+void OrderedOutputBuf::append(const shared_ptr<Completion> &completion)
+{
+   _segments.emplace_back();
+   _segments.back().completion = completion;
+   ++_pending;
+}
+
+
+bool OrderedOutputBuf::drain(CompletionPool &pool, size_t maxPending)
+{
+   while( !_segments.empty() )
+   {
+      Segment &segment = _segments.front();
+
+      if( segment.completion )
+      {
+         if( !segment.completion->done )
+         {
+            if( _pending <= maxPending )
+               break;
+            pool.wait(*segment.completion);
+         }
+
+         if( !reportCompletion(*segment.completion) )
+            return false;
+
+         _target->sputn(segment.completion->output.data(), segment.completion->output.size());
+         string().swap(segment.completion->output);
+         segment.completion.reset();
+         --_pending;
+      }
+
+      _target->sputn(segment.text.data(), segment.text.size());
+      segment.text.clear();
+
+      if( _segments.size() == 1 )
+         break;
+      _segments.pop_front();
+   }
+
+   return true;
+}
+
+
+// CompletionCache methods
+size_t CompletionCache::_hash(const Completion &completion)
+{
+   size_t hash = std::hash<int>()(completion.sense);
+
+   auto combine = [&hash](size_t value) {
+      hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+   };
+
+   for( int i = 0; i < completion.objective->size(); ++i )
+   {
+      combine(std::hash<int>()(completion.objective->index(i)));
+      combine(std::hash<double>()(static_cast<double>(completion.objective->value(i))));
+   }
+
+   for( auto index : completion.active )
+      combine(std::hash<long>()(index));
+
+   return hash;
+}
+
+
+bool CompletionCache::_equal(const Completion &first, const Completion &second)
+{
+   if( first.sense != second.sense || first.active != second.active )
+      return false;
+
+   if( first.objective == second.objective )
+      return true;
+
+   if( first.objective->size() != second.objective->size() )
+      return false;
+
+   for( int i = 0; i < first.objective->size(); ++i )
+   {
+      if( first.objective->index(i) != second.objective->index(i)
+         || first.objective->value(i) != second.objective->value(i) )
+         return false;
+   }
+
    return true;
 }
+
+
+shared_ptr<Completion> CompletionCache::findOrInsert(const shared_ptr<Completion> &completion)
+{
+   size_t hash = _hash(*completion);
+   auto range = _index.equal_range(hash);
+
+   for( auto it = range.first; it != range.second; ++it )
+   {
+      if( _equal(*it->second->completion, *completion) )
+         return it->second->completion;
+   }
+
+   _entries.push_back(Entry{hash, completion});
+   _index.insert(make_pair(hash, prev(_entries.end())));
+
+   if( _entries.size() > _maxSize )
+   {
+      range = _index.equal_range(_entries.front().hash);
+
+      for( auto it = range.first; it != range.second; ++it )
+      {
+         if( it->second == _entries.begin() )
+         {
+            _index.erase(it);
+            break;
+         }
+      }
+      _entries.pop_front();
+   }
+
+   return nullptr;
+}
@@ -0,0 +1,270 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Converts certificates between the text format .vipr and the binary format .viprb
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <sys/stat.h>
+#include "viprio.h"
+#include "viprbin.h"
+#include "viprstream.h"
+
+#define VERSION_MAJOR 1
+#define VERSION_MINOR 1
+
+using namespace std;
+
+static long long fileSize(const string &filename)
+{
+   struct stat st;
+
+   return stat(filename.c_str(), &st) == 0 ? (long long)st.st_size : -1;
+}
+
+
+// Copies all tokens, the line structure and the comments of the input
+static bool convert(CertificateInput &in, ostream &out, bool toBinary, BinaryWriter &writer,
+   uint64_t &bytesWritten)
+{
+   Token token;
+   bool first = true;
+   bool more = in.next(token);
+
+   if( toBinary )
+      writer.writeHeader();
+
+   while( more )
+   {
+      bool lineBreak = in.lineBreak() && !first;
+      string comment;
+
+      // a comment extends to the end of its line
+      if( token.size > 0 && token.data[0] == '%' )
+      {
+         comment = token.str();
+         while( (more = in.next(token)) && !in.lineBreak() )
+            comment += " " + token.str();
+      }
+
+      if( toBinary )
+      {
+         // a number directly followed by the closing bracket of a derivation is stored as two
+         // tokens, such that the number is stored by value
+         size_t size = token.size;
+
+         if( comment.empty() && size > 1 && token.data[size - 1] == '}'
+            && (unsigned)(token.data[size - 2] - '0') <= 9 )
+            --size;
+
+         if( lineBreak )
+            writer.writeLineBreak();
+         if( !comment.empty() )
+            writer.writeString(comment.data(), comment.size());
+         else
+         {
+            writer.writeToken(token.data, size);
+            if( size < token.size )
+               writer.writeToken("}", 1);
+         }
+      }
+      else
+      {
+         if( !first )
+            out.put(lineBreak ? '\n' : ' ');
+         if( comment.empty() )
+            out.write(token.data, token.size);
+         else
+            out << comment;
+         bytesWritten += (first ? 0 : 1) + (comment.empty() ? token.size : comment.size());
+      }
+
+      first = false;
+
+      if( comment.empty() )
+         more = in.next(token);
+   }
+
+   if( toBinary )
+   {
+      writer.writeLineBreak();
+      bytesWritten = writer.bytesWritten();
+      return writer.finish();
+   }
+
+   out.put('\n');
+   ++bytesWritten;
+   return !out.fail();
+}
+
+
+int main(int argc, char *argv[])
+{
+   int rs = -1;
+   int farg = 0;
+   int oarg = 0;
+   int to = -1;                    // -1: opposite of the input, 0: text, 1: binary
+   bool setCompression = false;
+   Compression compression = Compression::NONE;
+   string compressionName;
+
+   for( int i = 1; i < argc; ++i )
+   {
+      string arg = argv[i];
+
+      if( arg.compare(0, 11, "--compress=") == 0 && parseCompression(arg.substr(11), compression) )
+      {
+         setCompression = true;
+         compressionName = arg.substr(11);
+      }
+      else if( arg == "--to=binary" )
+         to = 1;
+      else if( arg == "--to=text" )
+         to = 0;
+      else if( arg.compare(0, 2, "--") != 0 && farg == 0 )
+         farg = i;
+      else if( arg.compare(0, 2, "--") != 0 && oarg == 0 )
+         oarg = i;
+      else
+      {
+         farg = 0;
+         break;
+      }
+   }
+
+   if( farg == 0 )
+   {
+      cerr << "Usage: " << argv[0] << " [--to=binary|text] [--compress=none|gzip|zstd] filename [output]\n" << endl;
+      cerr << "Converts a text certificate to the binary format and vice versa.  The output is" << endl;
+      cerr << "named after the input with extension .viprb or .vipr and compressed like the input" << endl;
+      cerr << "unless --compress is given.  --compress adds its extension to an output name" << endl;
+      cerr << "without one and must match the extension of an output name that has one." << endl;
+      return rs;
+   }
+
+   CertificateInput in;
+
+   if( !in.open(argv[farg]) )
+   {
+      cerr << "Failed to open file " << argv[farg] << endl;
+      return rs;
+   }
+
+   bool toBinary = (to < 0 ? !in.isBinary() : to == 1);
+   string outFname;
+
+   if( oarg != 0 )
+   {
+      // the output is compressed as its name says, so --compress extends a plain name
+      outFname = argv[oarg];
+      Compression outputCompression = compressionFromName(outFname);
+
+      if( setCompression && outputCompression == Compression::NONE )
+         outFname += compressionExtension(compression);
+      else if( setCompression && outputCompression != compression )
+      {
+         cerr << "Output file " << outFname << " does not match --compress=" << compressionName << endl;
+         return rs;
+      }
+   }
+   else
+   {
+      // file.vipr.gz becomes file.viprb.gz and vice versa
+      outFname = argv[farg];
+      Compression inputCompression = stripCompressionExtension(outFname);
+      string extension = (toBinary ? ".viprb" : ".vipr");
+
+      for( const char* old : { ".viprb", ".vipr" } )
+      {
+         size_t n = strlen(old);
+
+         if( outFname.size() > n && outFname.compare(outFname.size() - n, n, old) == 0 )
+         {
+            outFname.resize(outFname.size() - n);
+            break;
+         }
+      }
+
+      if( !setCompression )
+         compression = inputCompression;
+      outFname += extension + compressionExtension(compression);
+   }
+
+   if( outFname == argv[farg] )
+   {
+      cerr << "Output file " << outFname << " would overwrite the input" << endl;
+      return rs;
+   }
+
+   OutputFile out;
+
+   out.open(outFname);
+
+   if( out.fail() )
+   {
+      cerr << "Failed to open file " << outFname << endl;
+      return rs;
+   }
+
+   auto start = chrono::steady_clock::now();
+   BinaryWriter writer(out);
+   uint64_t bytesWritten = 0;
+   bool success = convert(in, out, toBinary, writer, bytesWritten);
+
+   out.close();
+   success = success && !out.fail();
+
+   chrono::duration<double> duration = chrono::steady_clock::now() - start;
+
+   if( !success )
+   {
+      cerr << "Error encountered while converting file" << endl;
+      return rs;
+   }
+
+   long long inSize = fileSize(argv[farg]);
+   long long outSize = fileSize(outFname);
+
+   cout << "Converted " << argv[farg] << " (" << (in.isBinary() ? "binary" : "text") << ", "
+        << inSize / 1e6 << " MB) to " << outFname << " (" << (toBinary ? "binary" : "text") << ", "
+        << outSize / 1e6 << " MB) in " << duration.count() << " seconds" << endl;
+   cout << "Uncompressed size " << in.bytesRead() / 1e6 << " MB -> " << bytesWritten / 1e6 << " MB" << endl;
+
+   if( toBinary )
+   {
+      auto &sections = writer.sections();
+
+      for( size_t i = 0; i < sections.size(); ++i )
+      {
+         uint64_t end = (i + 1 < sections.size() ? sections[i + 1].second : bytesWritten);
+
+         cout << "   " << sections[i].first << " " << (end - sections[i].second) / 1e6 << " MB" << endl;
+      }
+   }
+
+   rs = 0;
+
+   return rs;
+}
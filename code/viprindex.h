@@ -0,0 +1,407 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Sidecar offset index of a certificate
+//
+// The index of certificate file.vipr is stored next to it as file.vipr.idx and lets the tools
+// jump to any derivation without reading the ones before it.  It holds the offset right after
+// each section keyword and, for every derivation of the DER section, its offset, its length and
+// the constraint indices it references (the lin/rnd multipliers and the four uns indices).
+// Offsets count bytes of the decompressed certificate, starting with the whitespace before the
+// label, i.e., they are what InputFile::tellg() or CertificateInput::bytesRead() return after
+// the preceding token.  Building the index reads the certificate once without converting any
+// numbers.  An index remembers size and modification time of its certificate and is only
+// loaded if both still match.
+//
+// The file starts with the 8 bytes "VIPRIDX\n" followed by LEB128 varints: format version,
+// certificate size and modification time, number of CON constraints, the section table
+// (number of sections, then length, name and offset of each), number of derivations and, per
+// derivation, the gap to the end of the previous one, its length, its number of references and
+// the zigzag encoded references.
+
+#ifndef VIPRINDEX_H
+#define VIPRINDEX_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include "viprio.h"
+
+
+static const char INDEX_MAGIC[] = "VIPRIDX\n";
+static const size_t INDEX_MAGIC_SIZE = 8;
+static const uint64_t INDEX_FORMAT_VERSION = 1;
+
+
+class CertificateIndex
+{
+   public:
+      static std::string fileName(const std::string &certificate) { return certificate + ".idx"; }
+
+      bool build(const char* certificate); // reads the certificate; false if it is malformed
+      bool load(const char* certificate);  // false if there is no index matching the certificate
+      bool save(const char* certificate) const;
+
+      int numberOfConstraints() const { return _numberOfConstraints; }
+      int numberOfDerivations() const { return int(_offset.size()); }
+
+      // offset right after the keyword of the given section, 0 if it is unknown
+      size_t sectionOffset(const std::string &name) const;
+
+      size_t offset(int k) const { return _offset[k]; }
+      size_t length(int k) const { return _length[k]; }
+      const int* references(int k, size_t &count) const
+      {
+         count = _refStart[k + 1] - _refStart[k];
+         return _refs.data() + _refStart[k];
+      }
+
+   private:
+      static bool _stat(const char* certificate, uint64_t &size, uint64_t &modified);
+      static bool _skipVector(CertificateInput &in);
+
+      uint64_t _size = 0;
+      uint64_t _modified = 0;
+      int _numberOfConstraints = 0;
+      std::vector<std::pair<std::string, uint64_t> > _sections;
+      std::vector<uint64_t> _offset;
+      std::vector<uint64_t> _length;
+      std::vector<uint64_t> _refStart{0};
+      std::vector<int> _refs;
+};
+
+
+// CertificateIndex methods
+inline bool CertificateIndex::_stat(const char* certificate, uint64_t &size, uint64_t &modified)
+{
+   struct stat st;
+
+   if( stat(certificate, &st) != 0 )
+      return false;
+
+   size = uint64_t(st.st_size);
+   modified = uint64_t(st.st_mtime);
+   return true;
+}
+
+
+// Skips a sparse vector, i.e., its number of nonzeros and the index/value pairs, or "OBJ"
+inline bool CertificateIndex::_skipVector(CertificateInput &in)
+{
+   Token token;
+   long k;
+
+   if( !in.next(token) )
+      return false;
+   if( token == "OBJ" )
+      return true;
+   if( !CertificateInput::toLong(token, k) || k < 0 )
+      return false;
+
+   for( long j = 0; j < 2 * k; ++j )
+   {
+      if( !in.skip() )
+         return false;
+   }
+
+   return true;
+}
+
+
+inline size_t CertificateIndex::sectionOffset(const std::string &name) const
+{
+   for( auto &section : _sections )
+   {
+      if( section.first == name )
+         return section.second;
+   }
+
+   return 0;
+}
+
+
+inline bool CertificateIndex::build(const char* certificate)
+{
+   static const char* const keywords[] = { "VAR", "INT", "OBJ", "CON", "RTP", "SOL", "DER" };
+
+   CertificateInput in;
+   std::string str;
+   Token token;
+   long n, m;
+
+   *this = CertificateIndex();
+
+   if( !_stat(certificate, _size, _modified) || !in.open(certificate) )
+      return false;
+
+   // comments before VER
+   for( ;; )
+   {
+      if( !in.next(token) )
+         return false;
+      if( token == "VER" )
+         break;
+      if( token.size == 0 || token.data[0] != '%' )
+         return false;
+      in.skipLine();
+   }
+   _sections.push_back(std::make_pair(std::string("VER"), in.bytesRead()));
+   in.skip();
+
+   for( const char* keyword : keywords )
+   {
+      if( !in.next(token) || token != keyword )
+         return false;
+
+      _sections.push_back(std::make_pair(std::string(keyword), in.bytesRead()));
+      str = keyword;
+
+      if( str == "VAR" || str == "INT" )
+      {
+         in >> n;
+         for( long i = 0; i < n && !in.fail(); ++i )
+            in.skip();
+      }
+      else if( str == "OBJ" )
+      {
+         if( !in.skip() || !_skipVector(in) )
+            return false;
+      }
+      else if( str == "CON" )
+      {
+         in >> n >> m;
+         _numberOfConstraints = int(n);
+
+         for( long i = 0; i < n && !in.fail(); ++i )
+         {
+            in.skip();
+            in.skip();
+            in.skip();
+            if( !_skipVector(in) )
+               return false;
+         }
+      }
+      else if( str == "RTP" )
+      {
+         in >> str;
+         if( str == "range" )
+         {
+            in.skip();
+            in.skip();
+         }
+      }
+      else if( str == "SOL" )
+      {
+         in >> n;
+         for( long i = 0; i < n && !in.fail(); ++i )
+         {
+            in.skip();
+            if( !_skipVector(in) )
+               return false;
+         }
+      }
+      else
+      {
+         in >> n;
+         if( in.fail() || n < 0 )
+            return false;
+
+         _offset.reserve(n);
+         _length.reserve(n);
+         _refStart.reserve(n + 1);
+
+         for( long i = 0; i < n; ++i )
+         {
+            size_t start = in.bytesRead();
+            int index;
+
+            in.skip();
+            in.skip();
+            in.skip();
+            if( !_skipVector(in) || !in.next(token) || token != "{" || !in.next(token) )
+               return false;
+
+            if( token == "lin" || token == "rnd" )
+            {
+               in >> m;
+               for( long j = 0; j < m && !in.fail(); ++j )
+               {
+                  in >> index;
+                  in.skipNumber();
+                  _refs.push_back(index);
+               }
+            }
+            else if( token == "uns" )
+            {
+               for( int j = 0; j < 4; ++j )
+               {
+                  in >> index;
+                  _refs.push_back(index);
+               }
+            }
+
+            if( !in.next(token) || token != "}" || !in.skip() )
+               return false;
+
+            _offset.push_back(start);
+            _length.push_back(in.bytesRead() - start);
+            _refStart.push_back(_refs.size());
+         }
+      }
+
+      if( in.fail() )
+         return false;
+   }
+
+   return true;
+}
+
+
+inline bool CertificateIndex::save(const char* certificate) const
+{
+   std::string data(INDEX_MAGIC, INDEX_MAGIC_SIZE);
+   uint64_t end = 0;
+
+   auto varint = [&data](uint64_t value) {
+      while( value >= 0x80 )
+      {
+         data.push_back(char(0x80 | (value & 0x7f)));
+         value >>= 7;
+      }
+      data.push_back(char(value));
+   };
+
+   varint(INDEX_FORMAT_VERSION);
+   varint(_size);
+   varint(_modified);
+   varint(uint64_t(_numberOfConstraints));
+   varint(_sections.size());
+   for( auto &section : _sections )
+   {
+      varint(section.first.size());
+      data += section.first;
+      varint(section.second);
+   }
+
+   varint(_offset.size());
+   for( size_t k = 0; k < _offset.size(); ++k )
+   {
+      varint(_offset[k] - end);
+      varint(_length[k]);
+      varint(_refStart[k + 1] - _refStart[k]);
+      for( uint64_t r = _refStart[k]; r < _refStart[k + 1]; ++r )
+         varint(zigzagEncode(_refs[r]));
+      end = _offset[k] + _length[k];
+   }
+
+   std::ofstream out(fileName(certificate), std::ios::binary);
+
+   out.write(data.data(), data.size());
+   out.close();
+
+   return !out.fail();
+}
+
+
+inline bool CertificateIndex::load(const char* certificate)
+{
+   std::ifstream in(fileName(certificate), std::ios::binary);
+   uint64_t size, modified, value, count, end = 0;
+
+   *this = CertificateIndex();
+
+   if( !in || !_stat(certificate, size, modified) )
+      return false;
+
+   std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+   const char* p = data.data();
+   const char* stop = p + data.size();
+
+   auto varint = [&p, stop](uint64_t &v) {
+      p = (p != nullptr ? decodeVarint(p, stop, v) : nullptr);
+      return p != nullptr;
+   };
+
+   if( data.size() < INDEX_MAGIC_SIZE || memcmp(p, INDEX_MAGIC, INDEX_MAGIC_SIZE) != 0 )
+      return false;
+   p += INDEX_MAGIC_SIZE;
+
+   if( !varint(value) || value != INDEX_FORMAT_VERSION || !varint(_size) || !varint(_modified)
+      || _size != size || _modified != modified || !varint(value) || !varint(count) )
+      return false;
+
+   _numberOfConstraints = int(value);
+
+   for( uint64_t i = 0; i < count; ++i )
+   {
+      if( !varint(value) || value > uint64_t(stop - p) )
+         return false;
+
+      std::string name(p, value);
+
+      p += value;
+      if( !varint(value) )
+         return false;
+      _sections.push_back(std::make_pair(name, value));
+   }
+
+   if( !varint(count) || count > data.size() )
+      return false;
+
+   _offset.reserve(count);
+   _length.reserve(count);
+   _refStart.reserve(count + 1);
+
+   for( uint64_t k = 0; k < count; ++k )
+   {
+      uint64_t gap, length, refs;
+
+      if( !varint(gap) || !varint(length) || !varint(refs) || refs > uint64_t(stop - p) )
+         return false;
+
+      for( uint64_t r = 0; r < refs; ++r )
+      {
+         if( !varint(value) )
+            return false;
+         _refs.push_back(int(zigzagDecode(value)));
+      }
+
+      _offset.push_back(end + gap);
+      _length.push_back(length);
+      _refStart.push_back(_refs.size());
+      end += gap + length;
+   }
+
+   if( p != stop )
+   {
+      *this = CertificateIndex();
+      return false;
+   }
+
+   return true;
+}
+
+#endif
@@ -0,0 +1,1326 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Input of .vipr certificate files
+//
+// CertificateInput splits a certificate into whitespace separated tokens without copying them.
+// Uncompressed regular files are memory-mapped and tokens point directly into the mapping;
+// everything else, including gzip and zstd compressed certificates, is read in large blocks
+// into a buffer through an InputFile.  Binary certificates (see viprbin.h) are detected by
+// their first bytes and decoded directly, such that the same extraction operators read numbers
+// without any decimal conversion.  The extraction operators mimic std::istream, i.e.,
+// a failed read sets a sticky fail flag that can be queried by fail().  Values are parsed by a
+// dedicated parser for rational and decimal literals, which avoids GMP for all values whose
+// numerator and denominator fit into 64 bits.  With startReadAhead(), a background thread reads
+// the next block (or faults in the next window of a mapping) while the current one is
+// tokenized, so that disk and decompression latency overlap with the work of the caller.
+// With follow(), an uncompressed file that is still being written is read like tail -f does:
+// at its current end, reading waits for more data instead of failing.
+
+#ifndef VIPRIO_H
+#define VIPRIO_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <gmpxx.h>
+#include "viprrational.h"
+#include "viprstream.h"
+#include "viprbin.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VIPR_HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+// View of a token inside the input buffer.  Only valid until the next read from the input
+struct Token
+{
+   const char* data = nullptr;
+   size_t size = 0;
+
+   bool operator==(const char* str) const { return strlen(str) == size && memcmp(data, str, size) == 0; }
+   bool operator!=(const char* str) const { return !(*this == str); }
+   std::string str() const { return std::string(data, size); }
+};
+
+
+// Rational literals of the form [+-]digits[/digits] or [+-]digits.digits
+//
+// parseSmallRational() handles literals whose numerator and denominator fit into 64 bits without
+// touching GMP; the result is reduced.  parseRational() writes any literal into an mpq_t,
+// reusing its limb storage.  Both return false if the literal is malformed.
+
+struct RationalLiteral
+{
+   bool negative = false;
+   const char* num = nullptr;    // integer digits of the numerator
+   size_t numDigits = 0;
+   const char* frac = nullptr;   // fractional digits of a decimal
+   size_t fracDigits = 0;
+   const char* den = nullptr;    // digits of the denominator of a fraction
+   size_t denDigits = 0;
+};
+
+
+// Splits a literal into its digit ranges
+inline bool splitRational(const char* str, size_t size, RationalLiteral &lit)
+{
+   const char* p = str;
+   const char* end = str + size;
+
+   lit = RationalLiteral();
+
+   if( p < end && (*p == '-' || *p == '+') )
+      lit.negative = (*p++ == '-');
+
+   lit.num = p;
+   while( p < end && (unsigned)(*p - '0') <= 9 )
+      ++p;
+   lit.numDigits = p - lit.num;
+
+   if( p < end && *p == '.' )
+   {
+      lit.frac = ++p;
+      while( p < end && (unsigned)(*p - '0') <= 9 )
+         ++p;
+      lit.fracDigits = p - lit.frac;
+   }
+   else if( p < end && *p == '/' )
+   {
+      lit.den = ++p;
+      while( p < end && (unsigned)(*p - '0') <= 9 )
+         ++p;
+      lit.denDigits = p - lit.den;
+
+      if( lit.denDigits == 0 )
+         return false;
+   }
+
+   return p == end && lit.numDigits + lit.fracDigits > 0;
+}
+
+
+inline uint64_t digitsToUInt64(const char* digits, size_t count, uint64_t value = 0)
+{
+   for( size_t i = 0; i < count; ++i )
+      value = 10 * value + (digits[i] - '0');
+   return value;
+}
+
+
+// Returns true and the reduced value num/den if the literal has at most 19 significant digits in
+// numerator and denominator; den is positive
+inline bool parseSmallRational(const RationalLiteral &lit, int64_t &num, uint64_t &den)
+{
+   static const uint64_t pow10[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+      10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+      10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+      100000000000000000ULL, 1000000000000000000ULL };
+
+   // 10^18 < 2^63, so 18 digits always fit into the signed numerator
+   if( lit.numDigits + lit.fracDigits > 18 || lit.denDigits > 19 )
+      return false;
+
+   uint64_t n = digitsToUInt64(lit.frac, lit.fracDigits, digitsToUInt64(lit.num, lit.numDigits));
+   uint64_t d = lit.den != nullptr ? digitsToUInt64(lit.den, lit.denDigits) : pow10[lit.fracDigits];
+
+   if( d == 0 )
+      return false;
+
+   if( d != 1 && n != 0 )
+   {
+      uint64_t g = gcdUInt64(n, d);
+      n /= g;
+      d /= g;
+   }
+   else if( n == 0 )
+      d = 1;
+
+   num = lit.negative ? -int64_t(n) : int64_t(n);
+   den = d;
+   return true;
+}
+
+
+inline bool parseRational(const char* str, size_t size, mpq_t q, std::string &scratch)
+{
+   RationalLiteral lit;
+   int64_t num;
+   uint64_t den;
+
+   if( !splitRational(str, size, lit) )
+      return false;
+
+   // fast path: set the limbs directly, the value is already canonical
+   if( sizeof(unsigned long) >= sizeof(uint64_t) && parseSmallRational(lit, num, den) )
+   {
+      mpz_set_ui(mpq_numref(q), (unsigned long)(num < 0 ? -(uint64_t)num : num));
+      if( num < 0 )
+         mpz_neg(mpq_numref(q), mpq_numref(q));
+      mpz_set_ui(mpq_denref(q), (unsigned long)den);
+      return true;
+   }
+
+   scratch.assign(lit.num, lit.numDigits);
+   scratch.append(lit.frac, lit.fracDigits);
+   mpz_set_str(mpq_numref(q), scratch.c_str(), 10);
+   if( lit.negative )
+      mpz_neg(mpq_numref(q), mpq_numref(q));
+
+   if( lit.den != nullptr )
+   {
+      scratch.assign(lit.den, lit.denDigits);
+      mpz_set_str(mpq_denref(q), scratch.c_str(), 10);
+      if( mpz_sgn(mpq_denref(q)) == 0 )
+         return false;
+   }
+   else
+      mpz_ui_pow_ui(mpq_denref(q), 10, lit.fracDigits);
+
+   mpq_canonicalize(q);
+   return true;
+}
+
+
+class CertificateInput
+{
+   public:
+      CertificateInput() {}
+      ~CertificateInput() { close(); }
+
+      bool open(const char* filename);
+      bool openMemory(const char* data, size_t size); // text that outlives the input
+      void close();
+      void startReadAhead();   // reads the following blocks on a background thread
+
+      // before open(): at the end of the file, wait until it grows, the marker file exists or
+      // nothing was appended for timeout seconds
+      void follow(double timeout, const std::string &marker);
+
+      bool fail() const { return _fail; }
+      bool isMapped() const { return _mapped; }
+      bool isStream() const { return _input.isStream(); } // standard input or a pipe
+      const char* mappedData() const { return _mapped ? _begin : nullptr; } // whole mapping
+      bool isBinary() const { return _binary; }
+      bool lineBreak() const { return _lineBreak; } // whether the last token started a new line
+
+      // number of bytes consumed so far and total size of the input (0 if unknown)
+      size_t bytesRead() const { return _consumed + size_t(_pos - _begin); }
+      size_t size() const { return _size; }
+      double readAheadWait() const { return _aheadWait; } // seconds spent waiting for read-ahead
+      double followWait() const { return _followWait; }   // seconds spent waiting for the file to grow
+
+      bool next(Token &token); // reads the next token
+      bool nextIsNumber();     // whether the next token is stored as number (binary input only)
+      bool skip();             // skips the next token without converting it
+      bool skipNumber();       // skips the next token like a number read by operator>>
+      bool skipBytes(size_t size); // skips size bytes of the (decompressed) input
+      bool seek(size_t offset);    // continues reading at an offset given by bytesRead()
+      void skipLine();         // skips the remainder of the current line
+
+      static bool toLong(const Token &token, long &value); // parses a token as an integer
+
+      CertificateInput& operator>>(std::string &str);
+      CertificateInput& operator>>(char &c);
+      CertificateInput& operator>>(int &i);
+      CertificateInput& operator>>(long &l);
+      CertificateInput& operator>>(mpq_class &q);
+#ifdef VIPR_HAVE_HYBRID_RATIONAL
+      CertificateInput& operator>>(HybridRational &q);
+#endif
+
+   private:
+      static const size_t _blockSize = 1 << 20;
+      static const size_t _aheadSize = 4 << 20;
+
+      static bool _isSpace(char c) { return (unsigned char)c <= ' '; }
+      void _splitBracket(Token &token);
+      bool _refill();
+      bool _ensure(size_t size);
+      size_t _readInput(char* dest, size_t size);
+
+      // read-ahead
+      void _readAhead();
+      void _stopReadAhead();
+      void _waitAhead(std::unique_lock<std::mutex> &lock);
+      size_t _takeAhead(char* dest);
+      bool _nextWindow();
+
+      // binary input
+      bool _readHeader();
+      bool _peekItem(BinaryItem &type);
+      bool _readItem(BinaryItem &type, uint64_t &payload);
+      bool _readVarint(uint64_t &value);
+      bool _skipPayload(BinaryItem type, uint64_t payload);
+      bool _readBigNumber(uint64_t payload, mpq_t q);
+      bool _readRational(mpq_t q);
+      bool _binaryToken(Token &token);
+
+      InputFile _input;
+      bool _mapped = false;
+      bool _binary = false;
+      bool _fail = false;
+      bool _eof = false;
+      bool _lineBreak = false;
+      size_t _size = 0;
+      size_t _consumed = 0;      // bytes consumed before _begin
+      std::vector<char> _buffer;
+      const char* _begin = nullptr;
+      const char* _pos = nullptr;
+      const char* _end = nullptr;
+      std::string _scratch;
+      std::string _text;           // binary numbers rendered as text
+      std::string _pending;        // rest of a binary token after extracting a char
+      bool _hasPending = false;
+      mpq_class _big;
+
+      std::thread _aheadThread;
+      std::mutex _aheadMutex;
+      std::condition_variable _aheadChanged;
+      bool _readingAhead = false;
+      bool _aheadReady = false;    // the thread has finished the current request
+      bool _aheadStop = false;
+      std::vector<char> _ahead;    // next block of streamed input
+      size_t _aheadGot = 0;
+      const char* _windowEnd = nullptr; // end of the window faulted in for mapped input
+      double _aheadWait = 0.0;
+
+      bool _following = false;
+      double _followTimeout = 0.0;
+      std::string _followMarker;
+      double _followWait = 0.0;
+};
+
+
+inline bool CertificateInput::open(const char* filename)
+{
+   close();
+
+#ifdef VIPR_HAVE_MMAP
+   bool mappable = !_following && !::isStream(filename) && detectCompression(filename) == Compression::NONE;
+   int fd = mappable ? ::open(filename, O_RDONLY) : -1;
+   struct stat st;
+
+   if( fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 )
+   {
+      void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if( map != MAP_FAILED )
+      {
+         madvise(map, st.st_size, MADV_SEQUENTIAL);
+         ::close(fd);
+
+         _mapped = true;
+         _eof = true;
+         _size = st.st_size;
+         _begin = _pos = static_cast<const char*>(map);
+         _end = _begin + _size;
+         return _readHeader();
+      }
+   }
+   if( fd >= 0 )
+      ::close(fd);
+#endif
+
+   // not mappable, read in blocks instead
+   _input.open(filename);
+   if( _input.fail() )
+   {
+      _fail = true;
+      return false;
+   }
+
+   _buffer.resize(2 * _blockSize);
+   _begin = _pos = _end = _buffer.data();
+   return _readHeader();
+}
+
+
+// Tokenizes text in memory, e.g., a part of a mapped certificate handled by another thread
+inline bool CertificateInput::openMemory(const char* data, size_t size)
+{
+   close();
+
+   _eof = true;
+   _size = size;
+   _begin = _pos = data;
+   _end = data + size;
+
+   return true;
+}
+
+
+inline void CertificateInput::close()
+{
+   _stopReadAhead();
+
+#ifdef VIPR_HAVE_MMAP
+   if( _mapped )
+      munmap(const_cast<char*>(_begin), _size);
+#endif
+   _input.close();
+
+   _mapped = false;
+   _binary = false;
+   _fail = false;
+   _eof = false;
+   _lineBreak = false;
+   _hasPending = false;
+   _size = 0;
+   _consumed = 0;
+   _begin = _pos = _end = nullptr;
+}
+
+
+// Moves the unconsumed part of the buffer to its front and appends the next block.
+// Returns false if no more data is available
+inline bool CertificateInput::_refill()
+{
+   if( _eof )
+      return false;
+
+   if( _mapped )
+      return _nextWindow();
+
+   size_t keep = _end - _pos;
+   size_t start = _pos - _begin;
+   size_t blockSize = (_readingAhead ? _aheadSize : _blockSize);
+   size_t got;
+
+   _consumed += start;
+   if( keep + blockSize > _buffer.size() )
+      _buffer.resize(keep + blockSize);
+   memmove(_buffer.data(), _buffer.data() + start, keep);
+
+   if( _readingAhead )
+      got = _takeAhead(_buffer.data() + keep);
+   else
+      got = _readInput(_buffer.data() + keep, blockSize);
+
+   if( got == 0 )
+      _eof = true;
+
+   _begin = _pos = _buffer.data();
+   _end = _begin + keep + got;
+
+   return got > 0;
+}
+
+
+inline void CertificateInput::follow(double timeout, const std::string &marker)
+{
+   _following = true;
+   _followTimeout = timeout;
+   _followMarker = marker;
+}
+
+
+// Reads from the InputFile.  When following, an empty read is retried after a short sleep; the
+// marker is checked before the retry, so data written before the marker was created is not
+// missed.  Compressed files and streams are not followed, a stream blocks by itself
+inline size_t CertificateInput::_readInput(char* dest, size_t size)
+{
+   _input.read(dest, size);
+
+   size_t got = _input.gcount();
+
+   if( got > 0 || !_following || _input.compression() != Compression::NONE || _input.isStream() )
+      return got;
+
+   auto start = std::chrono::steady_clock::now();
+
+   for( ;; )
+   {
+      FILE* marker = fopen(_followMarker.c_str(), "r");
+      bool complete = (marker != nullptr);
+
+      if( marker != nullptr )
+         fclose(marker);
+
+      _input.clear();
+      _input.read(dest, size);
+      got = _input.gcount();
+
+      std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+      bool stop;
+
+      {
+         std::lock_guard<std::mutex> lock(_aheadMutex);
+         stop = _readingAhead && _aheadStop;
+      }
+
+      if( got > 0 || complete || stop || waited.count() >= _followTimeout )
+      {
+         _followWait += waited.count();
+         return got;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   }
+}
+
+
+// Mapped input is read ahead in windows: the tokenizer sees the mapping up to the end of the
+// window that the thread has faulted in, while the thread faults in the next one
+inline void CertificateInput::startReadAhead()
+{
+   if( _readingAhead || _fail || (!_mapped && _eof) )
+      return;
+
+   if( _mapped )
+   {
+      const char* mapEnd = _begin + _size;
+
+      if( size_t(mapEnd - _pos) <= _aheadSize )
+         return;
+
+      _end = _pos + _aheadSize;
+      _eof = false;
+      _windowEnd = _end + std::min(size_t(_aheadSize), size_t(mapEnd - _end));
+   }
+   else
+      _ahead.resize(_aheadSize);
+
+   _readingAhead = true;
+   _aheadReady = false;
+   _aheadStop = false;
+   _aheadThread = std::thread(&CertificateInput::_readAhead, this);
+}
+
+
+// Read-ahead thread: serves one request at a time, namely the next block of streamed input or
+// the pages up to _windowEnd of a mapping
+inline void CertificateInput::_readAhead()
+{
+   const char* faulted = _end;
+
+   for( ;; )
+   {
+      std::unique_lock<std::mutex> lock(_aheadMutex);
+
+      _aheadChanged.wait(lock, [this]() { return _aheadStop || !_aheadReady; });
+
+      if( _aheadStop )
+         return;
+
+      const char* windowEnd = _windowEnd;
+
+      lock.unlock();
+
+      if( _mapped )
+      {
+         volatile char sink = 0;
+
+         for( const char* p = faulted; p < windowEnd; p += 4096 )
+            sink = sink + *p;
+         faulted = windowEnd;
+      }
+      else
+         _aheadGot = _readInput(_ahead.data(), _aheadSize);
+
+      lock.lock();
+      _aheadReady = true;
+      lock.unlock();
+      _aheadChanged.notify_all();
+   }
+}
+
+
+inline void CertificateInput::_stopReadAhead()
+{
+   if( !_readingAhead )
+      return;
+
+   {
+      std::lock_guard<std::mutex> lock(_aheadMutex);
+      _aheadStop = true;
+   }
+   _aheadChanged.notify_all();
+   _aheadThread.join();
+
+   _readingAhead = false;
+   _ahead.clear();
+   _ahead.shrink_to_fit();
+}
+
+
+// Waits for the current request of the read-ahead thread and accounts the time
+inline void CertificateInput::_waitAhead(std::unique_lock<std::mutex> &lock)
+{
+   if( _aheadReady )
+      return;
+
+   auto start = std::chrono::steady_clock::now();
+
+   _aheadChanged.wait(lock, [this]() { return _aheadReady; });
+
+   std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+   _aheadWait += waited.count();
+}
+
+
+// Copies the block read ahead to dest and requests the next one
+inline size_t CertificateInput::_takeAhead(char* dest)
+{
+   std::unique_lock<std::mutex> lock(_aheadMutex);
+
+   _waitAhead(lock);
+
+   size_t got = _aheadGot;
+
+   memcpy(dest, _ahead.data(), got);
+
+   if( got > 0 )
+   {
+      _aheadReady = false;
+      lock.unlock();
+      _aheadChanged.notify_all();
+   }
+
+   return got;
+}
+
+
+// Extends the visible part of a mapping by the window faulted in and requests the next one
+inline bool CertificateInput::_nextWindow()
+{
+   std::unique_lock<std::mutex> lock(_aheadMutex);
+   const char* mapEnd = _begin + _size;
+
+   _waitAhead(lock);
+
+   _end = _windowEnd;
+   _eof = (_end == mapEnd);
+
+   if( !_eof )
+   {
+      _windowEnd = _end + std::min(size_t(_aheadSize), size_t(mapEnd - _end));
+      _aheadReady = false;
+      lock.unlock();
+      _aheadChanged.notify_all();
+   }
+
+   return true;
+}
+
+
+// Makes at least size bytes available after _pos; false if the input ends before
+inline bool CertificateInput::_ensure(size_t size)
+{
+   while( size_t(_end - _pos) < size )
+   {
+      if( !_refill() )
+         return false;
+   }
+
+   return true;
+}
+
+
+// Detects a binary certificate and skips its header
+inline bool CertificateInput::_readHeader()
+{
+   uint64_t version;
+
+   if( !_ensure(BINARY_MAGIC_SIZE) || memcmp(_pos, BINARY_MAGIC, BINARY_MAGIC_SIZE) != 0 )
+      return true;
+
+   _binary = true;
+   _pos += BINARY_MAGIC_SIZE;
+
+   if( !_readVarint(version) || version > BINARY_FORMAT_VERSION )
+   {
+      _fail = true;
+      return false;
+   }
+
+   return true;
+}
+
+
+inline bool CertificateInput::next(Token &token)
+{
+   if( _binary )
+      return _binaryToken(token);
+
+   _lineBreak = false;
+
+   for( ;; )
+   {
+      while( _pos < _end && _isSpace(*_pos) )
+      {
+         _lineBreak = _lineBreak || *_pos == '\n';
+         ++_pos;
+      }
+
+      if( _pos == _end )
+      {
+         if( _refill() )
+            continue;
+
+         _fail = true;
+         return false;
+      }
+
+      const char* p = _pos;
+
+      while( p < _end && !_isSpace(*p) )
+         ++p;
+
+      // the token may continue in the next block
+      if( p == _end && !_eof )
+      {
+         _refill();
+         continue;
+      }
+
+      token.data = _pos;
+      token.size = p - _pos;
+      _pos = p;
+
+      return true;
+   }
+}
+
+
+inline bool CertificateInput::skip()
+{
+   Token token;
+
+   if( _fail )
+      return false;
+
+   if( _binary && !_hasPending )
+   {
+      BinaryItem type = BinaryItem::END;
+      uint64_t payload = 0;
+
+      if( !_readItem(type, payload) || !_skipPayload(type, payload) )
+         _fail = true;
+
+      return !_fail;
+   }
+
+   return next(token);
+}
+
+
+// A number that is directly followed by the closing bracket of a derivation, as older versions
+// of viprcomp wrote it, ends before the bracket, which is left for the next read like a stream
+// extraction would leave it
+inline void CertificateInput::_splitBracket(Token &token)
+{
+   if( !_binary && token.size > 1 && token.data[token.size - 1] == '}' )
+   {
+      --token.size;
+      --_pos;
+   }
+}
+
+
+inline bool CertificateInput::skipNumber()
+{
+   Token token;
+
+   if( _fail )
+      return false;
+
+   if( _binary )
+      return skip();
+
+   if( !next(token) )
+      return false;
+
+   _splitBracket(token);
+   return true;
+}
+
+
+inline bool CertificateInput::skipBytes(size_t size)
+{
+   while( size > size_t(_end - _pos) )
+   {
+      size -= _end - _pos;
+      _pos = _end;
+
+      if( !_refill() )
+      {
+         _fail = true;
+         return false;
+      }
+   }
+
+   _pos += size;
+   return true;
+}
+
+
+// Mapped input and offsets within the buffer are served directly, otherwise the InputFile
+// seeks as described in viprstream.h.  Not available during read-ahead
+inline bool CertificateInput::seek(size_t offset)
+{
+   if( _readingAhead )
+      return false;
+
+   _fail = false;
+   _hasPending = false;
+   _lineBreak = false;
+
+   if( offset >= _consumed && offset <= _consumed + size_t(_end - _begin) )
+   {
+      _pos = _begin + (offset - _consumed);
+      return true;
+   }
+
+   if( _mapped || !_input.is_open() )
+   {
+      _fail = true;
+      return false;
+   }
+
+   _input.clear();
+   _input.seekg(std::streamoff(offset));
+
+   _consumed = offset;
+   _begin = _pos = _end = _buffer.data();
+   _eof = false;
+   _fail = _input.fail();
+
+   return !_fail;
+}
+
+
+inline void CertificateInput::skipLine()
+{
+   if( _binary )
+   {
+      BinaryItem type = BinaryItem::END;
+      uint64_t payload = 0;
+      const char* p;
+
+      _hasPending = false;
+
+      // consume items up to and including the next line break
+      for( ;; )
+      {
+         p = decodeItemHeader(_pos, _end, type, payload);
+
+         if( p == nullptr )
+         {
+            if( _refill() )
+               continue;
+            return;
+         }
+         if( type == BinaryItem::END )
+            return;
+
+         _pos = p;
+
+         if( type == BinaryItem::LINEBREAK || !_skipPayload(type, payload) )
+            return;
+      }
+   }
+
+   for( ;; )
+   {
+      const char* p = static_cast<const char*>(memchr(_pos, '\n', _end - _pos));
+
+      if( p != nullptr )
+      {
+         _pos = p + 1;
+         return;
+      }
+
+      _pos = _end;
+      if( !_refill() )
+         return;
+   }
+}
+
+
+inline bool CertificateInput::toLong(const Token &token, long &value)
+{
+   const char* p = token.data;
+   const char* end = p + token.size;
+   bool negative = false;
+   unsigned long v = 0;
+
+   if( p < end && (*p == '-' || *p == '+') )
+      negative = (*p++ == '-');
+
+   if( p == end )
+      return false;
+
+   for( ; p < end; ++p )
+   {
+      unsigned digit = (unsigned)(*p - '0');
+
+      if( digit > 9 || v > (ULONG_MAX - digit) / 10 )
+         return false;
+      v = 10 * v + digit;
+   }
+
+   if( v > (unsigned long)LONG_MAX + (negative ? 1 : 0) )
+      return false;
+
+   value = (negative && v > 0) ? -(long)(v - 1) - 1 : (long)v;
+   return true;
+}
+
+
+// Skips line breaks and returns the type of the next item, whose header is then in the buffer
+inline bool CertificateInput::_peekItem(BinaryItem &type)
+{
+   uint64_t payload = 0;
+
+   _lineBreak = false;
+
+   for( ;; )
+   {
+      const char* p = decodeItemHeader(_pos, _end, type, payload);
+
+      if( p == nullptr )
+      {
+         if( _refill() )
+            continue;
+
+         return false;
+      }
+
+      if( type != BinaryItem::LINEBREAK )
+         return true;
+
+      _pos = p;
+      _lineBreak = true;
+   }
+}
+
+
+// Reads the header of the next item other than a line break; fails at the END item
+inline bool CertificateInput::_readItem(BinaryItem &type, uint64_t &payload)
+{
+   if( !_peekItem(type) || type == BinaryItem::END )
+   {
+      _fail = true;
+      return false;
+   }
+
+   _pos = decodeItemHeader(_pos, _end, type, payload);
+   return true;
+}
+
+
+inline bool CertificateInput::_readVarint(uint64_t &value)
+{
+   for( ;; )
+   {
+      const char* p = decodeVarint(_pos, _end, value);
+
+      if( p != nullptr )
+      {
+         _pos = p;
+         return true;
+      }
+
+      if( !_refill() )
+      {
+         _fail = true;
+         return false;
+      }
+   }
+}
+
+
+inline bool CertificateInput::_skipPayload(BinaryItem type, uint64_t payload)
+{
+   uint64_t value;
+
+   switch( type )
+   {
+      case BinaryItem::INTEGER:
+      case BinaryItem::LINEBREAK:
+         return true;
+      case BinaryItem::FRACTION:
+         return _readVarint(value);
+      case BinaryItem::BIGNUMBER:
+         if( !_readVarint(value) || (payload >> 1) > (SIZE_MAX >> 5) || value > (SIZE_MAX >> 5) )
+            return false;
+         return skipBytes(8 * ((payload >> 1) + value));
+      case BinaryItem::STRING:
+         return skipBytes(payload);
+      default:
+         return false;
+   }
+}
+
+
+// Reads the limbs of a BIGNUMBER item into q and canonicalizes it
+inline bool CertificateInput::_readBigNumber(uint64_t payload, mpq_t q)
+{
+   uint64_t numLimbs = payload >> 1;
+   uint64_t denLimbs;
+
+   if( !_readVarint(denLimbs) || numLimbs > (SIZE_MAX >> 5) || denLimbs > (SIZE_MAX >> 5)
+      || !_ensure(8 * (numLimbs + denLimbs)) )
+   {
+      _fail = true;
+      return false;
+   }
+
+   mpz_import(mpq_numref(q), numLimbs, -1, 8, -1, 0, _pos);
+   if( payload & 1 )
+      mpz_neg(mpq_numref(q), mpq_numref(q));
+   _pos += 8 * numLimbs;
+
+   if( denLimbs == 0 )
+      mpz_set_ui(mpq_denref(q), 1);
+   else
+   {
+      mpz_import(mpq_denref(q), denLimbs, -1, 8, -1, 0, _pos);
+      _pos += 8 * denLimbs;
+
+      if( mpz_sgn(mpq_denref(q)) == 0 )
+      {
+         _fail = true;
+         return false;
+      }
+      mpq_canonicalize(q);
+   }
+
+   return true;
+}
+
+
+inline void setInt64(mpz_t z, int64_t value)
+{
+   if( sizeof(long) >= sizeof(int64_t) )
+      mpz_set_si(z, long(value));
+   else
+   {
+      uint64_t magnitude = value < 0 ? -(uint64_t)value : uint64_t(value);
+
+      mpz_import(z, 1, -1, sizeof(magnitude), 0, 0, &magnitude);
+      if( value < 0 )
+         mpz_neg(z, z);
+   }
+}
+
+
+// Reads an INTEGER, FRACTION or BIGNUMBER item into q
+inline bool CertificateInput::_readRational(mpq_t q)
+{
+   BinaryItem type = BinaryItem::END;
+   uint64_t payload = 0;
+   uint64_t den;
+
+   if( !_readItem(type, payload) )
+      return false;
+
+   switch( type )
+   {
+      case BinaryItem::INTEGER:
+         setInt64(mpq_numref(q), zigzagDecode(payload));
+         mpz_set_ui(mpq_denref(q), 1);
+         return true;
+      case BinaryItem::FRACTION:
+      {
+         int64_t num = zigzagDecode(payload);
+
+         if( !_readVarint(den) || den == 0 || den > uint64_t(INT64_MAX) )
+            break;
+
+         setInt64(mpq_numref(q), num);
+         setInt64(mpq_denref(q), int64_t(den));
+         if( den == 1 || gcdUInt64(num < 0 ? -(uint64_t)num : uint64_t(num), den) != 1 )
+            mpq_canonicalize(q);
+         return true;
+      }
+      case BinaryItem::BIGNUMBER:
+         return _readBigNumber(payload, q);
+      default:
+         break;
+   }
+
+   _fail = true;
+   return false;
+}
+
+
+// Whether the next item is a number that can be read without text conversion
+inline bool CertificateInput::nextIsNumber()
+{
+   BinaryItem type = BinaryItem::END;
+
+   return _binary && !_hasPending && _peekItem(type)
+      && (type == BinaryItem::INTEGER || type == BinaryItem::FRACTION || type == BinaryItem::BIGNUMBER);
+}
+
+
+// Returns the next item as text token: strings point into the buffer, numbers are rendered
+inline bool CertificateInput::_binaryToken(Token &token)
+{
+   BinaryItem type = BinaryItem::END;
+   uint64_t payload = 0;
+   uint64_t den;
+
+   if( _hasPending )
+   {
+      _hasPending = false;
+      token.data = _pending.data();
+      token.size = _pending.size();
+      return true;
+   }
+
+   if( !_readItem(type, payload) )
+      return false;
+
+   switch( type )
+   {
+      case BinaryItem::INTEGER:
+         _text = std::to_string((long long)zigzagDecode(payload));
+         break;
+      case BinaryItem::FRACTION:
+         if( !_readVarint(den) )
+            return false;
+         _text = std::to_string((long long)zigzagDecode(payload)) + "/" + std::to_string((unsigned long long)den);
+         break;
+      case BinaryItem::BIGNUMBER:
+         if( !_readBigNumber(payload, _big.get_mpq_t()) )
+            return false;
+         _text = _big.get_str();
+         break;
+      case BinaryItem::STRING:
+         if( !_ensure(payload) )
+         {
+            _fail = true;
+            return false;
+         }
+         token.data = _pos;
+         token.size = payload;
+         _pos += payload;
+         return true;
+      default:
+         _fail = true;
+         return false;
+   }
+
+   token.data = _text.data();
+   token.size = _text.size();
+   return true;
+}
+
+
+inline CertificateInput& CertificateInput::operator>>(std::string &str)
+{
+   Token token;
+
+   if( !_fail && next(token) )
+      str.assign(token.data, token.size);
+
+   return *this;
+}
+
+
+inline CertificateInput& CertificateInput::operator>>(char &c)
+{
+   if( _fail )
+      return *this;
+
+   if( _binary )
+   {
+      Token token;
+
+      // a token of more than one character is continued by the next read
+      if( next(token) )
+      {
+         c = token.data[0];
+         if( token.size > 1 )
+         {
+            _pending.assign(token.data + 1, token.size - 1);
+            _hasPending = true;
+         }
+      }
+      return *this;
+   }
+
+   for( ;; )
+   {
+      while( _pos < _end && _isSpace(*_pos) )
+         ++_pos;
+
+      if( _pos < _end )
+         break;
+
+      if( !_refill() )
+      {
+         _fail = true;
+         return *this;
+      }
+   }
+
+   c = *_pos++;
+   return *this;
+}
+
+
+inline CertificateInput& CertificateInput::operator>>(long &l)
+{
+   Token token;
+
+   if( _fail )
+      return *this;
+
+   if( _binary && !_hasPending && sizeof(long) >= sizeof(int64_t) )
+   {
+      BinaryItem type = BinaryItem::END;
+      uint64_t payload = 0;
+
+      if( _peekItem(type) && type == BinaryItem::INTEGER )
+      {
+         if( _readItem(type, payload) )
+            l = long(zigzagDecode(payload));
+         return *this;
+      }
+   }
+
+   if( next(token) )
+   {
+      _splitBracket(token);
+      if( !toLong(token, l) )
+         _fail = true;
+   }
+
+   return *this;
+}
+inline CertificateInput& CertificateInput::operator>>(int &i)
+{
+   long l;
+
+   if( !(*this >> l).fail() )
+   {
+      if( l < INT_MIN || l > INT_MAX )
+         _fail = true;
+      else
+         i = int(l);
+   }
+
+   return *this;
+}
+
+
+inline CertificateInput& CertificateInput::operator>>(mpq_class &q)
+{
+   Token token;
+
+   if( _fail )
+      return *this;
+
+   if( nextIsNumber() )
+   {
+      _readRational(q.get_mpq_t());
+      return *this;
+   }
+
+   if( next(token) )
+   {
+      _splitBracket(token);
+      if( !parseRational(token.data, token.size, q.get_mpq_t(), _scratch) )
+         _fail = true;
+   }
+
+   return *this;
+}
+
+
+#ifdef VIPR_HAVE_HYBRID_RATIONAL
+inline CertificateInput& CertificateInput::operator>>(HybridRational &q)
+{
+   Token token;
+   RationalLiteral lit;
+   int64_t num;
+   uint64_t den;
+
+   if( _fail )
+      return *this;
+
+   if( nextIsNumber() )
+   {
+      BinaryItem type = BinaryItem::END;
+      uint64_t payload = 0;
+
+      if( !_readItem(type, payload) )
+         return *this;
+
+      if( type == BinaryItem::INTEGER )
+         q = HybridRational(zigzagDecode(payload));
+      else if( type == BinaryItem::FRACTION )
+      {
+         if( _readVarint(den) && den != 0 && den <= uint64_t(INT64_MAX) )
+            q = HybridRational(zigzagDecode(payload), int64_t(den));
+         else
+            _fail = true;
+      }
+      else if( _readBigNumber(payload, _big.get_mpq_t()) )
+         q = _big;
+
+      return *this;
+   }
+
+   if( !next(token) )
+      return *this;
+
+   _splitBracket(token);
+
+   if( !splitRational(token.data, token.size, lit) )
+      _fail = true;
+   else if( parseSmallRational(lit, num, den) && den <= uint64_t(INT64_MAX) )
+      q = HybridRational(num, int64_t(den));
+   else
+   {
+      mpq_class value;
+
+      if( parseRational(token.data, token.size, value.get_mpq_t(), _scratch) )
+         q = value;
+      else
+         _fail = true;
+   }
+
+   return *this;
+}
+#endif
+
+#endif
@@ -0,0 +1,467 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Exact rational numbers that avoid GMP for small values
+//
+// HybridRational stores a reduced fraction with 64-bit numerator and denominator inline.  The
+// arithmetic operators compute with 128-bit intermediates, which cannot overflow for 64-bit
+// operands, and switch to an mpq_class only if the reduced result does not fit into 64 bits.
+// Results of GMP operations that fit again are stored inline, so every value has exactly one
+// representation.  HybridRational needs a compiler with __int128 support, which is indicated by
+// VIPR_HAVE_HYBRID_RATIONAL.
+
+#ifndef VIPRRATIONAL_H
+#define VIPRRATIONAL_H
+
+#include <cstdint>
+#include <cassert>
+#include <ostream>
+#include <utility>
+#include <string>
+#include <gmpxx.h>
+
+
+inline uint64_t gcdUInt64(uint64_t a, uint64_t b)
+{
+#ifdef __GNUC__
+   // binary gcd
+   if( a == 0 || b == 0 )
+      return a | b;
+
+   int shift = __builtin_ctzll(a | b);
+
+   a >>= __builtin_ctzll(a);
+   do
+   {
+      b >>= __builtin_ctzll(b);
+      if( a > b )
+      {
+         uint64_t t = a;
+         a = b;
+         b = t;
+      }
+      b -= a;
+   }
+   while( b != 0 );
+
+   return a << shift;
+#else
+   while( b != 0 )
+   {
+      uint64_t t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+#endif
+}
+
+
+#ifdef __SIZEOF_INT128__
+#define VIPR_HAVE_HYBRID_RATIONAL
+
+class HybridRational
+{
+   public:
+      HybridRational() {}
+      HybridRational(int i) : _num(i) {}
+      HybridRational(long i) { _setInteger(i); }
+      HybridRational(long long i) { _setInteger(i); }
+      HybridRational(const mpq_class &q) { _setBig(q); }
+      HybridRational(int64_t num, int64_t den); // any fraction with den != 0
+
+      HybridRational(const HybridRational &other) : _num(other._num), _den(other._den),
+         _big(other._big ? new mpq_class(*other._big) : nullptr) {}
+      HybridRational(HybridRational &&other) noexcept : _num(other._num), _den(other._den),
+         _big(other._big) { other._big = nullptr; }
+      ~HybridRational() { delete _big; }
+
+      HybridRational& operator=(const HybridRational &other);
+      HybridRational& operator=(HybridRational &&other) noexcept;
+
+      // inline representation num/den with den > 0, valid if isSmall()
+      bool isSmall() const { return _big == nullptr; }
+      int64_t num() const { assert(isSmall()); return _num; }
+      int64_t den() const { assert(isSmall()); return _den; }
+      const mpq_class& bigValue() const { assert(!isSmall()); return *_big; }
+
+      mpq_class get_mpq() const { return _big ? *_big : mpq_class(_mpz(_num), _mpz(_den)); }
+      double get_d() const { return get_mpq().get_d(); }
+      std::string get_str() const { return get_mpq().get_str(); }
+      int sign() const { return _big ? sgn(*_big) : (_num > 0) - (_num < 0); }
+
+      HybridRational& operator+=(const HybridRational &other);
+      HybridRational& operator-=(const HybridRational &other);
+      HybridRational& operator*=(const HybridRational &other);
+      HybridRational& operator/=(const HybridRational &other);
+      HybridRational operator-() const;
+
+      // sign of this - other
+      int compare(const HybridRational &other) const;
+
+      friend void swap(HybridRational &a, HybridRational &b) noexcept
+      {
+         std::swap(a._num, b._num);
+         std::swap(a._den, b._den);
+         std::swap(a._big, b._big);
+      }
+
+   private:
+      static bool _fits(__int128 v) { return v > INT64_MIN && v <= INT64_MAX; }
+      static mpz_class _mpz(__int128 v);
+
+      template <class Integer> void _setInteger(Integer i);
+      void _set(__int128 num, __int128 den); // reduced fraction, den > 0
+      void _setBig(const mpq_class &q);
+
+      // INT64_MIN is never stored, so that numerators can always be negated
+      int64_t _num = 0;
+      int64_t _den = 1;
+      mpq_class* _big = nullptr;
+};
+
+
+inline HybridRational operator+(HybridRational a, const HybridRational &b) { return a += b; }
+inline HybridRational operator-(HybridRational a, const HybridRational &b) { return a -= b; }
+inline HybridRational operator*(HybridRational a, const HybridRational &b) { return a *= b; }
+inline HybridRational operator/(HybridRational a, const HybridRational &b) { return a /= b; }
+
+inline bool operator==(const HybridRational &a, const HybridRational &b)
+{
+   if( a.isSmall() && b.isSmall() )
+      return a.num() == b.num() && a.den() == b.den();
+   else if( a.isSmall() != b.isSmall() ) // a value has only one representation
+      return false;
+   return a.bigValue() == b.bigValue();
+}
+
+inline bool operator!=(const HybridRational &a, const HybridRational &b) { return !(a == b); }
+inline bool operator<(const HybridRational &a, const HybridRational &b) { return a.compare(b) < 0; }
+inline bool operator<=(const HybridRational &a, const HybridRational &b) { return a.compare(b) <= 0; }
+inline bool operator>(const HybridRational &a, const HybridRational &b) { return a.compare(b) > 0; }
+inline bool operator>=(const HybridRational &a, const HybridRational &b) { return a.compare(b) >= 0; }
+
+inline int sgn(const HybridRational &q) { return q.sign(); }
+inline HybridRational abs(const HybridRational &q) { return q.sign() < 0 ? -q : q; }
+
+// same format as for mpq_class
+inline std::ostream& operator<<(std::ostream &out, const HybridRational &q)
+{
+   if( !q.isSmall() )
+      return out << q.bigValue();
+
+   out << q.num();
+   if( q.den() != 1 )
+      out << '/' << q.den();
+   return out;
+}
+
+
+inline HybridRational::HybridRational(int64_t num, int64_t den)
+{
+   assert(den != 0);
+
+   __int128 n = den < 0 ? -(__int128)num : num;
+   __int128 d = den < 0 ? -(__int128)den : den;
+   uint64_t g = gcdUInt64(uint64_t(n < 0 ? -n : n), uint64_t(d));
+
+   _set(n / g, d / g);
+}
+
+
+inline HybridRational& HybridRational::operator=(const HybridRational &other)
+{
+   if( other._big )
+   {
+      if( _big )
+         *_big = *other._big;
+      else
+         _big = new mpq_class(*other._big);
+   }
+   else
+   {
+      delete _big;
+      _big = nullptr;
+      _num = other._num;
+      _den = other._den;
+   }
+
+   return *this;
+}
+
+
+inline HybridRational& HybridRational::operator=(HybridRational &&other) noexcept
+{
+   swap(*this, other);
+   return *this;
+}
+
+
+inline mpz_class HybridRational::_mpz(__int128 v)
+{
+   unsigned __int128 magnitude = v < 0 ? -(unsigned __int128)v : v;
+   uint64_t words[2] = { uint64_t(magnitude), uint64_t(magnitude >> 64) };
+   mpz_class z;
+
+   mpz_import(z.get_mpz_t(), 2, -1, sizeof(uint64_t), 0, 0, words);
+   if( v < 0 )
+      z = -z;
+
+   return z;
+}
+
+
+template <class Integer>
+void HybridRational::_setInteger(Integer i)
+{
+   if( _fits(i) )
+      _num = int64_t(i);
+   else
+      _big = new mpq_class(_mpz(i));
+}
+
+
+inline void HybridRational::_set(__int128 num, __int128 den)
+{
+   assert(den > 0);
+
+   if( _fits(num) && _fits(den) )
+   {
+      delete _big;
+      _big = nullptr;
+      _num = int64_t(num);
+      _den = int64_t(den);
+   }
+   else
+   {
+      mpq_class q(_mpz(num), _mpz(den));
+
+      if( _big )
+         mpq_swap(_big->get_mpq_t(), q.get_mpq_t());
+      else
+         _big = new mpq_class(std::move(q));
+   }
+}
+
+
+// stores q inline if possible
+inline void HybridRational::_setBig(const mpq_class &q)
+{
+   mpz_srcptr num = q.get_num_mpz_t();
+   mpz_srcptr den = q.get_den_mpz_t();
+
+   if( mpz_sizeinbase(num, 2) <= 63 && mpz_sizeinbase(den, 2) <= 63 )
+   {
+      uint64_t n = 0;
+      uint64_t d = 0;
+
+      mpz_export(&n, nullptr, -1, sizeof(uint64_t), 0, 0, num);
+      mpz_export(&d, nullptr, -1, sizeof(uint64_t), 0, 0, den);
+
+      delete _big;
+      _big = nullptr;
+      _num = mpz_sgn(num) < 0 ? -int64_t(n) : int64_t(n);
+      _den = int64_t(d);
+   }
+   else if( _big != &q )
+   {
+      if( _big )
+         *_big = q;
+      else
+         _big = new mpq_class(q);
+   }
+}
+
+
+inline HybridRational& HybridRational::operator+=(const HybridRational &other)
+{
+   if( _big || other._big )
+   {
+      _setBig(get_mpq() + other.get_mpq());
+      return *this;
+   }
+
+   if( _den == other._den )
+   {
+      __int128 num = (__int128)_num + other._num;
+      uint64_t g = 1;
+
+      if( _den != 1 )
+         g = gcdUInt64(uint64_t((num < 0 ? -num : num) % _den), _den);
+
+      _set(num / g, _den / int64_t(g));
+   }
+   else
+   {
+      // Knuth, TAOCP Vol. 2, 4.5.1: reduce by the gcd of the denominators first
+      uint64_t g = gcdUInt64(_den, other._den);
+      __int128 num = (__int128)_num * (other._den / int64_t(g)) + (__int128)other._num * (_den / int64_t(g));
+
+      if( g == 1 )
+         _set(num, (__int128)_den * other._den);
+      else
+      {
+         uint64_t g2 = gcdUInt64(uint64_t((num < 0 ? -num : num) % g), g);
+
+         _set(num / g2, (__int128)(_den / int64_t(g)) * (other._den / int64_t(g2)));
+      }
+   }
+
+   return *this;
+}
+
+
+inline HybridRational& HybridRational::operator-=(const HybridRational &other)
+{
+   if( _big || other._big )
+   {
+      _setBig(get_mpq() - other.get_mpq());
+      return *this;
+   }
+
+   // negating a small numerator cannot overflow
+   HybridRational negative;
+
+   negative._num = -other._num;
+   negative._den = other._den;
+
+   return *this += negative;
+}
+
+
+inline HybridRational& HybridRational::operator*=(const HybridRational &other)
+{
+   if( _big || other._big )
+   {
+      _setBig(get_mpq() * other.get_mpq());
+      return *this;
+   }
+
+   if( _num == 0 || other._num == 0 )
+   {
+      _num = 0;
+      _den = 1;
+      return *this;
+   }
+
+   // cross reduction leaves a reduced product
+   int64_t g1 = int64_t(gcdUInt64(_num < 0 ? -_num : _num, other._den));
+   int64_t g2 = int64_t(gcdUInt64(other._num < 0 ? -other._num : other._num, _den));
+
+   _set((__int128)(_num / g1) * (other._num / g2), (__int128)(_den / g2) * (other._den / g1));
+
+   return *this;
+}
+
+
+inline HybridRational& HybridRational::operator/=(const HybridRational &other)
+{
+   assert(other.sign() != 0);
+
+   if( _big || other._big )
+   {
+      _setBig(get_mpq() / other.get_mpq());
+      return *this;
+   }
+
+   HybridRational inverse;
+
+   inverse._num = other._num < 0 ? -other._den : other._den;
+   inverse._den = other._num < 0 ? -other._num : other._num;
+
+   return *this *= inverse;
+}
+
+
+inline HybridRational HybridRational::operator-() const
+{
+   HybridRational negative(*this);
+
+   if( negative._big )
+      mpq_neg(negative._big->get_mpq_t(), negative._big->get_mpq_t());
+   else
+      negative._num = -negative._num;
+
+   return negative;
+}
+
+
+inline int HybridRational::compare(const HybridRational &other) const
+{
+   if( _big || other._big )
+      return cmp(get_mpq(), other.get_mpq());
+
+   __int128 lhs = (__int128)_num * other._den;
+   __int128 rhs = (__int128)other._num * _den;
+
+   return (lhs > rhs) - (lhs < rhs);
+}
+
+
+// rounding down
+inline HybridRational floor(const HybridRational &q)
+{
+   if( !q.isSmall() )
+   {
+      mpz_class z;
+      mpz_fdiv_q(z.get_mpz_t(), q.bigValue().get_num_mpz_t(), q.bigValue().get_den_mpz_t());
+      return HybridRational(mpq_class(z));
+   }
+
+   int64_t result = q.num() / q.den();
+
+   if( q.num() % q.den() != 0 && q.num() < 0 )
+      --result;
+
+   return HybridRational(result);
+}
+
+
+// rounding up
+inline HybridRational ceil(const HybridRational &q)
+{
+   if( !q.isSmall() )
+   {
+      mpz_class z;
+      mpz_cdiv_q(z.get_mpz_t(), q.bigValue().get_num_mpz_t(), q.bigValue().get_den_mpz_t());
+      return HybridRational(mpq_class(z));
+   }
+
+   int64_t result = q.num() / q.den();
+
+   if( q.num() % q.den() != 0 && q.num() > 0 )
+      ++result;
+
+   return HybridRational(result);
+}
+
+
+inline bool isInteger(const HybridRational &q)
+{
+   return q.isSmall() ? q.den() == 1 : q.bigValue().get_den() == 1;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,1140 @@
+/*
+*
+*   Copyright (c) 2022 Zuse Institute Berlin
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a
+*   copy of this software and associated documentation files (the "Software"),
+*   to deal in the Software without restriction, including without limitation
+*   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+*   and/or sell copies of the Software, and to permit persons to whom the
+*   Software is furnished to do so, subject to the following conditions:
+*
+*   The above copyright notice and this permission notice shall be included in
+*   all copies or substantial portions of the Software.
+*
+*   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+*   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+*   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+*   THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+*   LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+*   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+*   DEALINGS IN THE SOFTWARE.
+*
+*/
+
+// Compressed certificate files
+//
+// InputFile and OutputFile replace ifstream and ofstream in all tools.  InputFile detects gzip
+// and zstd compressed files by their first bytes and reads everything else as a plain file.
+// Compressed files are decompressed by DecompressBuf on a separate thread into a short queue of
+// blocks, so that decompression overlaps with parsing.  Seeking is supported for the two-pass
+// tools: forward seeks skip decompressed data, backward seeks within the last 16 MB are served
+// from the blocks kept in memory, and longer ones restart decompression, for gzip from the
+// closest of the access points recorded about every 16 MB.  Standard input, given as "-", and
+// named pipes are read the same way through DecompressBuf, compressed or not: the thread keeps
+// at most a few blocks ahead and otherwise blocks, so a writer into the pipe is held back
+// instead of data piling up in memory.  Such streams only support the short seeks.  OutputFile
+// compresses if the file name ends in .gz or .zst.
+//
+// gzip support requires zlib (VIPR_WITH_ZLIB), zstd support requires libzstd (VIPR_WITH_ZSTD).
+
+#ifndef VIPRSTREAM_H
+#define VIPRSTREAM_H
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef VIPR_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef VIPR_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define VIPR_FSEEK fseeko
+#else
+#define VIPR_FSEEK fseek
+#endif
+
+
+enum class Compression
+{
+   NONE,
+   GZIP,
+   ZSTD
+};
+
+
+// Compression of data determined by its first n bytes
+inline Compression compressionFromMagic(const unsigned char* magic, size_t n)
+{
+   if( n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b )
+      return Compression::GZIP;
+   else if( n >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd )
+      return Compression::ZSTD;
+
+   return Compression::NONE;
+}
+
+
+// Whether a file can only be read once from front to back: standard input ("-") or a pipe
+inline bool isStream(const char* filename)
+{
+   if( strcmp(filename, "-") == 0 )
+      return true;
+
+#if defined(__unix__) || defined(__APPLE__)
+   struct stat st;
+
+   return stat(filename, &st) == 0 && S_ISFIFO(st.st_mode);
+#else
+   return false;
+#endif
+}
+
+
+// Compression of a file determined by its first bytes; streams are not touched
+inline Compression detectCompression(const char* filename)
+{
+   unsigned char magic[4] = { 0, 0, 0, 0 };
+
+   if( isStream(filename) )
+      return Compression::NONE;
+
+   FILE* file = fopen(filename, "rb");
+
+   if( file == nullptr )
+      return Compression::NONE;
+
+   size_t n = fread(magic, 1, 4, file);
+   fclose(file);
+
+   return compressionFromMagic(magic, n);
+}
+
+
+// Compression of a file to be written determined by its name
+inline Compression compressionFromName(const std::string &filename)
+{
+   auto endsWith = [&filename](const char* suffix) {
+      size_t n = strlen(suffix);
+      return filename.size() >= n && filename.compare(filename.size() - n, n, suffix) == 0;
+   };
+
+   if( endsWith(".gz") )
+      return Compression::GZIP;
+   else if( endsWith(".zst") )
+      return Compression::ZSTD;
+
+   return Compression::NONE;
+}
+
+
+// File name extension of a compression, including the dot
+inline const char* compressionExtension(Compression compression)
+{
+   switch( compression )
+   {
+      case Compression::GZIP: return ".gz";
+      case Compression::ZSTD: return ".zst";
+      default: return "";
+   }
+}
+
+
+// Removes the extension of a compression from a file name; returns the compression found
+inline Compression stripCompressionExtension(std::string &filename)
+{
+   Compression compression = compressionFromName(filename);
+
+   filename.resize(filename.size() - strlen(compressionExtension(compression)));
+
+   return compression;
+}
+
+
+// Parses none, gzip/gz or zstd/zst
+inline bool parseCompression(const std::string &name, Compression &compression)
+{
+   if( name == "none" )
+      compression = Compression::NONE;
+   else if( name == "gzip" || name == "gz" )
+      compression = Compression::GZIP;
+   else if( name == "zstd" || name == "zst" )
+      compression = Compression::ZSTD;
+   else
+      return false;
+
+   return true;
+}
+
+
+inline bool compressionSupported(Compression compression)
+{
+   switch( compression )
+   {
+#ifdef VIPR_WITH_ZLIB
+      case Compression::GZIP: return true;
+#endif
+#ifdef VIPR_WITH_ZSTD
+      case Compression::ZSTD: return true;
+#endif
+      case Compression::NONE: return true;
+      default: return false;
+   }
+}
+
+
+class DecompressBuf : public std::streambuf
+{
+   public:
+      ~DecompressBuf() { close(); }
+
+      bool open(const char* filename, Compression compression);
+      bool openStream(const char* filename); // standard input or a pipe, compressed or not
+      void close();
+      bool is_open() const { return _compression != Compression::NONE || _stream != nullptr; }
+      bool isStream() const { return _stream != nullptr; }
+      Compression compression() const { return _compression; }
+
+   protected:
+      int_type underflow() override;
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override;
+      pos_type seekpos(pos_type pos, std::ios_base::openmode) override;
+
+   private:
+      static const size_t _blockSize = 1 << 20;
+      static const size_t _queueSize = 4;
+      static const size_t _historySize = 16;
+      static const uint64_t _pointSpacing = uint64_t(16) << 20;
+
+      struct Block
+      {
+         std::vector<char> data;
+         uint64_t start = 0;   // offset of the block in the decompressed data
+         bool last = false;
+      };
+
+      // state of the gzip decoder at a deflate block boundary, see zlib's examples/zran.c
+      struct AccessPoint
+      {
+         uint64_t out = 0;     // offset in the decompressed data
+         int64_t in = 0;       // offset of the first full byte in the file
+         int bits = 0;         // bits of the preceding byte that belong to the block
+         std::vector<unsigned char> window;
+      };
+
+      void _start(uint64_t position);
+      void _stop();
+      bool _nextBlock();
+      bool _seek(uint64_t position);
+
+      // decompression thread
+      void _run(long pointIndex);
+      bool _push(Block &block);
+      size_t _read(FILE* file, void* data, size_t size);
+      void _copy(FILE* file);
+      void _decompressGzip(FILE* file, long pointIndex);
+      void _decompressZstd(FILE* file);
+
+      std::string _filename;
+      Compression _compression = Compression::NONE;
+      FILE* _stream = nullptr;      // stream opened by openStream()
+      std::string _prefix;          // bytes read from the stream to detect its compression
+      Block _current;
+      bool _eof = false;
+      std::deque<Block> _history;   // blocks before the current one, for short backward seeks
+      std::deque<Block> _ahead;     // blocks after the current one after such a seek
+
+      std::thread _thread;
+      std::mutex _mutex;
+      std::condition_variable _changed;
+      std::deque<Block> _queue;
+      bool _stopRequested = false;
+      bool _error = false;
+      std::vector<AccessPoint> _points; // added by the thread, read only while it is stopped
+};
+
+
+class CompressBuf : public std::streambuf
+{
+   public:
+      ~CompressBuf() { close(); }
+
+      bool open(const char* filename, Compression compression);
+      bool close();
+      bool is_open() const { return _file != nullptr; }
+
+   protected:
+      int_type overflow(int_type c) override;
+      int sync() override;
+
+   private:
+      bool _compress(bool finish);
+
+      FILE* _file = nullptr;
+      Compression _compression = Compression::NONE;
+      std::vector<char> _buffer;
+      std::vector<char> _out;
+      bool _error = false;
+#ifdef VIPR_WITH_ZLIB
+      z_stream _zlib;
+#endif
+#ifdef VIPR_WITH_ZSTD
+      ZSTD_CStream* _zstd = nullptr;
+#endif
+};
+
+
+// Input file that is decompressed if necessary
+class InputFile : public std::istream
+{
+   public:
+      InputFile() : std::istream(&_plain) {}
+      ~InputFile() { close(); }
+
+      void open(const char* filename);
+      void open(const std::string &filename) { open(filename.c_str()); }
+      bool is_open() const { return _plain.is_open() || _compressed.is_open(); }
+      bool isStream() const { return _compressed.isStream(); }
+      void close();
+
+      Compression compression() const { return _compression; }
+
+   private:
+      std::filebuf _plain;
+      DecompressBuf _compressed;
+      Compression _compression = Compression::NONE;
+};
+
+
+// Output file that is compressed according to the extension of its name
+class OutputFile : public std::ostream
+{
+   public:
+      OutputFile() : std::ostream(&_plain) {}
+      ~OutputFile() { close(); }
+
+      void open(const char* filename);
+      void open(const std::string &filename) { open(filename.c_str()); }
+      bool is_open() const { return _plain.is_open() || _compressed.is_open(); }
+      void close();
+
+   private:
+      std::filebuf _plain;
+      CompressBuf _compressed;
+};
+
+
+// DecompressBuf methods
+inline bool DecompressBuf::open(const char* filename, Compression compression)
+{
+   close();
+
+   if( compression == Compression::NONE || !compressionSupported(compression) )
+      return false;
+
+   FILE* file = fopen(filename, "rb");
+
+   if( file == nullptr )
+      return false;
+
+   fclose(file);
+
+   _filename = filename;
+   _compression = compression;
+   _start(0);
+
+   return true;
+}
+
+
+// The first bytes are read here to detect the compression and handed to the thread later
+inline bool DecompressBuf::openStream(const char* filename)
+{
+   close();
+
+   bool isStdin = (strcmp(filename, "-") == 0);
+   unsigned char magic[4];
+
+   _stream = isStdin ? stdin : fopen(filename, "rb");
+
+   if( _stream == nullptr )
+      return false;
+
+   size_t n = fread(magic, 1, 4, _stream);
+
+   _filename = isStdin ? "standard input" : filename;
+   _prefix.assign(reinterpret_cast<char*>(magic), n);
+   _compression = compressionFromMagic(magic, n);
+
+   if( !compressionSupported(_compression) )
+   {
+      std::cerr << _filename << " is " << (_compression == Compression::GZIP ? "gzip" : "zstd")
+                << " compressed, but support for it was not compiled in" << std::endl;
+      close();
+      return false;
+   }
+
+   _start(0);
+
+   return true;
+}
+
+
+inline void DecompressBuf::close()
+{
+   _stop();
+   if( _stream != nullptr && _stream != stdin )
+      fclose(_stream);
+   _stream = nullptr;
+   _prefix.clear();
+   _compression = Compression::NONE;
+   _points.clear();
+   _current = Block();
+   _eof = false;
+   _history.clear();
+   _ahead.clear();
+   setg(nullptr, nullptr, nullptr);
+}
+
+
+// starts decompressing at the last access point before position
+inline void DecompressBuf::_start(uint64_t position)
+{
+   long point = -1;
+
+   while( point + 1 < long(_points.size()) && _points[point + 1].out <= position )
+      ++point;
+
+   _current = Block();
+   _current.start = point >= 0 ? _points[point].out : 0;
+   _eof = false;
+   _history.clear();
+   _ahead.clear();
+   _stopRequested = false;
+   _error = false;
+   setg(nullptr, nullptr, nullptr);
+
+   _thread = std::thread(&DecompressBuf::_run, this, point);
+}
+
+
+inline void DecompressBuf::_stop()
+{
+   if( _thread.joinable() )
+   {
+      {
+         std::lock_guard<std::mutex> lock(_mutex);
+         _stopRequested = true;
+      }
+      _changed.notify_all();
+      _thread.join();
+   }
+
+   _queue.clear();
+}
+
+
+// replaces the current block by the next one; false at the end of the data or on errors
+inline bool DecompressBuf::_nextBlock()
+{
+   if( _eof )
+      return false;
+
+   if( !_current.data.empty() )
+   {
+      _history.push_back(std::move(_current));
+      if( _history.size() > _historySize )
+         _history.pop_front();
+   }
+
+   if( !_ahead.empty() )
+   {
+      _current = std::move(_ahead.front());
+      _ahead.pop_front();
+      _eof = _current.last;
+      setg(_current.data.data(), _current.data.data(), _current.data.data() + _current.data.size());
+
+      return true;
+   }
+
+   std::unique_lock<std::mutex> lock(_mutex);
+
+   _changed.wait(lock, [this]() { return !_queue.empty() || _error; });
+
+   if( _queue.empty() )
+   {
+      std::cerr << "Error decompressing " << _filename << std::endl;
+      _eof = true;
+      return false;
+   }
+
+   _current = std::move(_queue.front());
+   _queue.pop_front();
+   lock.unlock();
+   _changed.notify_all();
+
+   _eof = _current.last;
+   setg(_current.data.data(), _current.data.data(), _current.data.data() + _current.data.size());
+
+   return true;
+}
+
+
+inline DecompressBuf::int_type DecompressBuf::underflow()
+{
+   while( gptr() == egptr() )
+   {
+      if( !_nextBlock() )
+         return traits_type::eof();
+   }
+
+   return traits_type::to_int_type(*gptr());
+}
+
+
+inline bool DecompressBuf::_seek(uint64_t position)
+{
+   if( position < _current.start )
+   {
+      if( !_history.empty() && position >= _history.front().start )
+      {
+         // step back through the recently decompressed blocks
+         while( position < _current.start )
+         {
+            if( !_current.data.empty() )
+               _ahead.push_front(std::move(_current));
+            _current = std::move(_history.back());
+            _history.pop_back();
+         }
+         _eof = _current.last;
+      }
+      else if( _stream != nullptr )
+         return false;
+      else
+      {
+         _stop();
+         _start(position);
+      }
+   }
+
+   while( position > _current.start + _current.data.size()
+          || (position == _current.start + _current.data.size() && !_eof) )
+   {
+      if( !_nextBlock() )
+         return false;
+   }
+
+   char* begin = _current.data.data();
+   setg(begin, begin + (position - _current.start), begin + _current.data.size());
+
+   return true;
+}
+
+
+inline DecompressBuf::pos_type DecompressBuf::seekoff(off_type off, std::ios_base::seekdir dir,
+   std::ios_base::openmode mode)
+{
+   uint64_t current = _current.start + (gptr() - eback());
+
+   if( dir == std::ios_base::cur )
+      return seekpos(pos_type(off_type(current) + off), mode);
+   else if( dir == std::ios_base::beg )
+      return seekpos(pos_type(off), mode);
+
+   return pos_type(off_type(-1));
+}
+
+
+inline DecompressBuf::pos_type DecompressBuf::seekpos(pos_type pos, std::ios_base::openmode)
+{
+   if( !is_open() || off_type(pos) < 0 || !_seek(uint64_t(off_type(pos))) )
+      return pos_type(off_type(-1));
+
+   return pos;
+}
+
+
+// hands a block to the reader; false if the thread should stop
+inline bool DecompressBuf::_push(Block &block)
+{
+   std::unique_lock<std::mutex> lock(_mutex);
+
+   _changed.wait(lock, [this]() { return _queue.size() < _queueSize || _stopRequested; });
+
+   if( _stopRequested )
+      return false;
+
+   uint64_t next = block.start + block.data.size();
+
+   _queue.push_back(std::move(block));
+   lock.unlock();
+   _changed.notify_all();
+
+   block = Block();
+   block.start = next;
+   block.data.reserve(_blockSize);
+
+   return true;
+}
+
+
+inline void DecompressBuf::_run(long pointIndex)
+{
+   FILE* file = (_stream != nullptr ? _stream : fopen(_filename.c_str(), "rb"));
+
+   if( file != nullptr )
+   {
+      if( _compression == Compression::GZIP )
+         _decompressGzip(file, pointIndex);
+      else if( _compression == Compression::ZSTD )
+         _decompressZstd(file);
+      else
+         _copy(file);
+
+      if( file != _stream )
+         fclose(file);
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _error = true;
+   }
+
+   _changed.notify_all();
+}
+
+
+// reads from the file, starting with the bytes read by openStream()
+inline size_t DecompressBuf::_read(FILE* file, void* data, size_t size)
+{
+   size_t n = std::min(size, _prefix.size());
+
+   memcpy(data, _prefix.data(), n);
+   _prefix.erase(0, n);
+
+   return n + (n < size ? fread(static_cast<char*>(data) + n, 1, size - n, file) : 0);
+}
+
+
+// passes an uncompressed stream on in blocks
+inline void DecompressBuf::_copy(FILE* file)
+{
+   Block block;
+
+   block.data.resize(_blockSize);
+
+   for( ;; )
+   {
+      size_t used = 0;
+
+      // fill the block completely unless the stream ends, pipes deliver less at a time
+      while( used < _blockSize )
+      {
+         size_t n = _read(file, block.data.data() + used, _blockSize - used);
+
+         if( n == 0 )
+            break;
+         used += n;
+      }
+
+      block.data.resize(used);
+      block.last = (used < _blockSize);
+
+      if( block.last )
+      {
+         if( ferror(file) )
+            break;
+         _push(block);
+         return;
+      }
+
+      if( !_push(block) )
+         return;
+
+      block.data.resize(_blockSize);
+   }
+
+   std::lock_guard<std::mutex> lock(_mutex);
+   _error = true;
+}
+
+
+inline void DecompressBuf::_decompressGzip(FILE* file, long pointIndex)
+{
+#ifdef VIPR_WITH_ZLIB
+   std::vector<unsigned char> input(1 << 18);
+   int64_t inputStart = 0;   // file offset of input[0]
+   size_t inputSize = 0;
+   bool inputEnd = false;
+   z_stream strm;
+   Block block;
+   AccessPoint point;
+   bool raw = (pointIndex >= 0);
+   bool success = false;
+   int ret = Z_OK;
+
+   auto refill = [&]() {
+      inputStart += inputSize;
+      inputSize = _read(file, input.data(), input.size());
+      inputEnd = (inputSize == 0);
+      strm.next_in = input.data();
+      strm.avail_in = uInt(inputSize);
+   };
+
+   memset(&strm, 0, sizeof(strm));
+
+   // copy, the thread adds further access points
+   if( raw )
+      point = _points[pointIndex];
+
+   block.start = raw ? point.out : 0;
+   block.data.reserve(_blockSize);
+
+   if( raw )
+   {
+      inputStart = point.in - (point.bits ? 1 : 0);
+      if( VIPR_FSEEK(file, inputStart, SEEK_SET) != 0 || inflateInit2(&strm, -15) != Z_OK )
+         goto TERMINATE;
+
+      if( point.bits )
+      {
+         int c = getc(file);
+
+         if( c == EOF )
+         {
+            inflateEnd(&strm);
+            goto TERMINATE;
+         }
+         inflatePrime(&strm, point.bits, c >> (8 - point.bits));
+         ++inputStart;
+      }
+      inflateSetDictionary(&strm, point.window.data(), uInt(point.window.size()));
+   }
+   else if( inflateInit2(&strm, 47) != Z_OK ) // gzip or zlib header
+      goto TERMINATE;
+
+   while( true )
+   {
+      if( strm.avail_in == 0 && !inputEnd )
+         refill();
+
+      if( ret == Z_STREAM_END )
+      {
+         // concatenated members; in raw mode the trailer has to be skipped by hand
+         for( int skip = raw ? 8 : 0; skip > 0 && strm.avail_in > 0; --skip )
+         {
+            ++strm.next_in;
+            if( --strm.avail_in == 0 && !inputEnd )
+               refill();
+         }
+         raw = false;
+
+         // trailing zeros or garbage are ignored like gzip does
+         if( strm.avail_in == 0 || strm.next_in[0] != 0x1f )
+         {
+            success = true;
+            break;
+         }
+         inflateReset2(&strm, 47);
+      }
+
+      size_t used = block.data.size();
+
+      block.data.resize(_blockSize);
+      strm.next_out = reinterpret_cast<unsigned char*>(block.data.data()) + used;
+      strm.avail_out = uInt(_blockSize - used);
+
+      ret = inflate(&strm, Z_BLOCK);
+      block.data.resize(_blockSize - strm.avail_out);
+
+      // Z_BUF_ERROR only means that more input is needed, unless there is none
+      if( (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+          || (ret == Z_BUF_ERROR && inputEnd) )
+         break;
+
+      uint64_t out = block.start + block.data.size();
+
+      // record an access point at the end of a deflate block
+      if( (strm.data_type & 128) && !(strm.data_type & 64) && ret != Z_STREAM_END
+          && out >= (_points.empty() ? _pointSpacing : _points.back().out + _pointSpacing) )
+      {
+         AccessPoint newPoint;
+         uInt length = 32768;
+
+         newPoint.out = out;
+         newPoint.in = inputStart + (strm.next_in - input.data());
+         newPoint.bits = strm.data_type & 7;
+         newPoint.window.resize(length);
+         if( inflateGetDictionary(&strm, newPoint.window.data(), &length) == Z_OK )
+         {
+            newPoint.window.resize(length);
+            _points.push_back(std::move(newPoint));
+         }
+      }
+
+      if( block.data.size() == _blockSize && !_push(block) )
+      {
+         inflateEnd(&strm);
+         return;
+      }
+   }
+
+   inflateEnd(&strm);
+
+   if( success )
+   {
+      block.last = true;
+      _push(block);
+      return;
+   }
+
+TERMINATE:
+   std::lock_guard<std::mutex> lock(_mutex);
+   _error = true;
+#else
+   (void)file;
+   (void)pointIndex;
+   std::lock_guard<std::mutex> lock(_mutex);
+   _error = true;
+#endif
+}
+
+
+inline void DecompressBuf::_decompressZstd(FILE* file)
+{
+#ifdef VIPR_WITH_ZSTD
+   std::vector<char> input(ZSTD_DStreamInSize());
+   ZSTD_DStream* stream = ZSTD_createDStream();
+   ZSTD_inBuffer in = { input.data(), 0, 0 };
+   Block block;
+   size_t ret = 0;
+   bool success = false;
+   bool drained = true; // the decoder holds no pending output
+
+   block.data.reserve(_blockSize);
+
+   if( stream != nullptr && !ZSTD_isError(ZSTD_initDStream(stream)) )
+   {
+      while( true )
+      {
+         if( in.pos == in.size && drained )
+         {
+            in.size = _read(file, input.data(), input.size());
+            in.pos = 0;
+
+            if( in.size == 0 )
+            {
+               success = (ret == 0); // complete frame
+               break;
+            }
+         }
+
+         size_t used = block.data.size();
+
+         block.data.resize(_blockSize);
+
+         ZSTD_outBuffer out = { block.data.data() + used, _blockSize - used, 0 };
+
+         ret = ZSTD_decompressStream(stream, &out, &in);
+         block.data.resize(used + out.pos);
+         drained = (out.pos < out.size);
+
+         if( ZSTD_isError(ret) )
+            break;
+
+         if( block.data.size() == _blockSize && !_push(block) )
+         {
+            ZSTD_freeDStream(stream);
+            return;
+         }
+      }
+   }
+
+   ZSTD_freeDStream(stream);
+
+   if( success )
+   {
+      block.last = true;
+      _push(block);
+      return;
+   }
+#else
+   (void)file;
+#endif
+
+   std::lock_guard<std::mutex> lock(_mutex);
+   _error = true;
+}
+
+
+// CompressBuf methods
+inline bool CompressBuf::open(const char* filename, Compression compression)
+{
+   close();
+
+   if( compression == Compression::NONE || !compressionSupported(compression) )
+      return false;
+
+   _file = fopen(filename, "wb");
+
+   if( _file == nullptr )
+      return false;
+
+   _compression = compression;
+   _error = false;
+   _buffer.resize(1 << 18);
+   _out.resize(1 << 18);
+   setp(_buffer.data(), _buffer.data() + _buffer.size());
+
+#ifdef VIPR_WITH_ZLIB
+   if( compression == Compression::GZIP )
+   {
+      memset(&_zlib, 0, sizeof(_zlib));
+      _error = (deflateInit2(&_zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8,
+                             Z_DEFAULT_STRATEGY) != Z_OK);
+   }
+#endif
+#ifdef VIPR_WITH_ZSTD
+   if( compression == Compression::ZSTD )
+   {
+      _zstd = ZSTD_createCStream();
+      _error = (_zstd == nullptr || ZSTD_isError(ZSTD_initCStream(_zstd, 3)));
+   }
+#endif
+
+   return !_error;
+}
+
+
+// compresses the buffered data; finish ends the compressed stream
+inline bool CompressBuf::_compress(bool finish)
+{
+   size_t size = pptr() - pbase();
+
+#ifdef VIPR_WITH_ZLIB
+   if( _compression == Compression::GZIP )
+   {
+      int ret;
+
+      _zlib.next_in = reinterpret_cast<unsigned char*>(pbase());
+      _zlib.avail_in = uInt(size);
+
+      do
+      {
+         _zlib.next_out = reinterpret_cast<unsigned char*>(_out.data());
+         _zlib.avail_out = uInt(_out.size());
+         ret = deflate(&_zlib, finish ? Z_FINISH : Z_NO_FLUSH);
+
+         if( ret == Z_STREAM_ERROR )
+            return false;
+
+         size_t n = _out.size() - _zlib.avail_out;
+
+         if( fwrite(_out.data(), 1, n, _file) != n )
+            return false;
+      }
+      while( _zlib.avail_out == 0 || (finish && ret != Z_STREAM_END) );
+   }
+#endif
+#ifdef VIPR_WITH_ZSTD
+   if( _compression == Compression::ZSTD )
+   {
+      ZSTD_inBuffer in = { pbase(), size, 0 };
+      size_t remaining = 1;
+
+      while( in.pos < in.size )
+      {
+         ZSTD_outBuffer out = { _out.data(), _out.size(), 0 };
+
+         if( ZSTD_isError(ZSTD_compressStream(_zstd, &out, &in))
+             || fwrite(_out.data(), 1, out.pos, _file) != out.pos )
+            return false;
+      }
+
+      while( finish && remaining > 0 )
+      {
+         ZSTD_outBuffer out = { _out.data(), _out.size(), 0 };
+
+         remaining = ZSTD_endStream(_zstd, &out);
+         if( ZSTD_isError(remaining) || fwrite(_out.data(), 1, out.pos, _file) != out.pos )
+            return false;
+      }
+   }
+#endif
+
+   (void)size;
+   (void)finish;
+   setp(_buffer.data(), _buffer.data() + _buffer.size());
+
+   return true;
+}
+
+
+inline CompressBuf::int_type CompressBuf::overflow(int_type c)
+{
+   if( _error || !_compress(false) )
+   {
+      _error = true;
+      return traits_type::eof();
+   }
+
+   if( !traits_type::eq_int_type(c, traits_type::eof()) )
+   {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+   }
+
+   return traits_type::not_eof(c);
+}
+
+
+// only passes the buffer to the compressor; the compressed stream is completed by close()
+inline int CompressBuf::sync()
+{
+   if( _error || !_compress(false) )
+   {
+      _error = true;
+      return -1;
+   }
+
+   return 0;
+}
+
+
+inline bool CompressBuf::close()
+{
+   if( _file == nullptr )
+      return true;
+
+   if( !_error && !_compress(true) )
+      _error = true;
+
+#ifdef VIPR_WITH_ZLIB
+   if( _compression == Compression::GZIP )
+      deflateEnd(&_zlib);
+#endif
+#ifdef VIPR_WITH_ZSTD
+   ZSTD_freeCStream(_zstd);
+   _zstd = nullptr;
+#endif
+
+   if( fclose(_file) != 0 )
+      _error = true;
+   _file = nullptr;
+   setp(nullptr, nullptr);
+
+   return !_error;
+}
+
+
+// InputFile methods
+inline void InputFile::open(const char* filename)
+{
+   close();
+
+   if( ::isStream(filename) )
+   {
+      if( _compressed.openStream(filename) )
+      {
+         _compression = _compressed.compression();
+         rdbuf(&_compressed);
+         return;
+      }
+      setstate(std::ios_base::failbit);
+      return;
+   }
+
+   _compression = detectCompression(filename);
+
+   if( _compression == Compression::NONE )
+   {
+      if( _plain.open(filename, std::ios_base::in) )
+      {
+         rdbuf(&_plain);
+         return;
+      }
+   }
+   else if( !compressionSupported(_compression) )
+      std::cerr << filename << " is " << (_compression == Compression::GZIP ? "gzip" : "zstd")
+                << " compressed, but support for it was not compiled in" << std::endl;
+   else if( _compressed.open(filename, _compression) )
+   {
+      rdbuf(&_compressed);
+      return;
+   }
+
+   setstate(std::ios_base::failbit);
+}
+
+
+inline void InputFile::close()
+{
+   _plain.close();
+   _compressed.close();
+   _compression = Compression::NONE;
+}
+
+
+// OutputFile methods
+inline void OutputFile::open(const char* filename)
+{
+   Compression compression = compressionFromName(filename);
+
+   close();
+
+   if( compression == Compression::NONE )
+   {
+      if( _plain.open(filename, std::ios_base::out | std::ios_base::trunc) )
+      {
+         rdbuf(&_plain);
+         return;
+      }
+   }
+   else if( !compressionSupported(compression) )
+      std::cerr << "Cannot write " << filename << ": support for "
+                << (compression == Compression::GZIP ? "gzip" : "zstd")
+                << " was not compiled in" << std::endl;
+   else if( _compressed.open(filename, compression) )
+   {
+      rdbuf(&_compressed);
+      return;
+   }
+
+   setstate(std::ios_base::failbit);
+}
+
+
+inline void OutputFile::close()
+{
+   bool success = true;
+
+   if( is_open() )
+      flush();
+
+   if( _plain.is_open() )
+      success = (_plain.close() != nullptr);
+   else if( _compressed.is_open() )
+      success = _compressed.close();
+
+   if( !success )
+      setstate(std::ios_base::failbit);
+}
+
+#endif
@@ -27,6 +27,8 @@
 #include <fstream>
 #include <vector>
 #include <functional>
+#include "viprstream.h"
+#include "viprindex.h"
 
 #define VERSION_MAJOR 1
 #define VERSION_MINOR 1
@@ -49,8 +51,9 @@ class Node {
    int newIdx = -1;
 };
 
-bool firstPass( ifstream &pf, int &numCon, vector<Node> &nodes, streampos &fposDer );
-bool writeReorderedDER( ifstream &pf, ofstream &optF, streampos fposDer, int &numCon, vector<Node> &nodes, vector<int> &L );
+bool firstPass( InputFile &pf, int &numCon, vector<Node> &nodes, streampos &fposDer );
+void indexedPass( const CertificateIndex &index, int &numCon, vector<Node> &nodes, streampos &fposDer );
+bool writeReorderedDER( InputFile &pf, OutputFile &optF, streampos fposDer, int &numCon, vector<Node> &nodes, vector<int> &L );
 
 int main(int argc, char *argv[])
 {
@@ -58,19 +61,43 @@ int main(int argc, char *argv[])
    bool stat = false;
    int numCon;
 
-   ifstream pf; // input vipr file
+   InputFile pf; // input vipr file, possibly compressed
    streampos fposDer = -1;
-   ofstream optF; // optimized vipr file
+   OutputFile optF; // optimized vipr file
 
    vector<Node> nodes; // node list for derived constraints
 
 
    int rs = -1;
-   int farg = 1;
+   int farg = 0;
+   bool setCompression = false;
+   bool buildIndex = false;
+   Compression compression = Compression::NONE;
+   CertificateIndex index;
 
-   if( argc != 2 )
+   for( int i = 1; i < argc; ++i )
    {
-      cerr << "Usage: " << argv[0] << " filename\n" << endl;
+      string arg = argv[i];
+
+      if( arg.compare(0, 11, "--compress=") == 0 && parseCompression(arg.substr(11), compression) )
+         setCompression = true;
+      else if( arg == "--index" )
+         buildIndex = true;
+      else if( farg == 0 && arg.compare(0, 2, "--") != 0 )
+         farg = i;
+      else
+      {
+         farg = 0;
+         break;
+      }
+   }
+
+   if( farg == 0 )
+   {
+      cerr << "Usage: " << argv[0] << " [--compress=none|gzip|zstd] [--index] filename\n" << endl;
+      cerr << "The input may be gzip or zstd compressed.  Unless --compress is given, the" << endl;
+      cerr << "output filename.opt is compressed like the input.  The derivations are located" << endl;
+      cerr << "through the index filename.idx if it is up to date; --index creates it otherwise." << endl;
       return rs;
    }
 
@@ -84,7 +111,13 @@ int main(int argc, char *argv[])
    }
 
 
-   string optFname = string(argv[farg]) + ".opt";
+   // file.vipr.gz becomes file.vipr.opt.gz
+   string optFname = argv[farg];
+   stripCompressionExtension(optFname);
+
+   if( !setCompression )
+      compression = pf.compression();
+   optFname += string(".opt") + compressionExtension(compression);
 
    optF.open( optFname.c_str());
 
@@ -94,7 +127,20 @@ int main(int argc, char *argv[])
       return rs;
    }
 
-   if( !firstPass( pf, numCon, nodes, fposDer ) ) goto TERMINATE;
+   if( index.load( argv[farg] ) )
+   {
+      cout << "Using index " << CertificateIndex::fileName( argv[farg] ) << endl;
+   }
+   else if( buildIndex )
+   {
+      if( !index.build( argv[farg] ) ) goto TERMINATE;
+      if( !index.save( argv[farg] ) )
+         cerr << "Failed to write index " << CertificateIndex::fileName( argv[farg] ) << endl;
+   }
+
+   if( index.numberOfDerivations() > 0 )
+      indexedPass( index, numCon, nodes, fposDer );
+   else if( !firstPass( pf, numCon, nodes, fposDer ) ) goto TERMINATE;
 
 
 #ifndef NDEBUG
@@ -185,7 +231,7 @@ TERMINATE:
 // constraints and outputs the vipr file up to right before DER.
 // returns the file position right after numDer.
 // returns -1 if an error has occurred.
-bool firstPass( ifstream &pf, int &numCon, vector<Node> &nodes, streampos &fposDer )
+bool firstPass( InputFile &pf, int &numCon, vector<Node> &nodes, streampos &fposDer )
 {
    string section, tmp, label;
    char sense;
@@ -571,7 +617,34 @@ TERMINATE:
    return stat;
 }
 
-bool writeReorderedDER( ifstream &pf, ofstream &optF, streampos fposDer, int &numCon, vector<Node> &nodes, vector<int> &L )
+// constructs the digraph from the references stored in the index instead of
+// reading the certificate
+void indexedPass( const CertificateIndex &index, int &numCon, vector<Node> &nodes, streampos &fposDer )
+{
+   numCon = index.numberOfConstraints();
+   fposDer = index.sectionOffset( "DER" );
+
+   nodes.resize( index.numberOfDerivations() );
+
+   for( int i = 0; i < index.numberOfDerivations(); ++i )
+   {
+      size_t count;
+      const int* refs = index.references( i, count );
+
+      nodes[i].fpos = streampos( index.offset( i ) );
+
+      for( size_t j = 0; j < count; ++j )
+      {
+         if( refs[j] >= numCon && refs[j] - numCon < int( nodes.size() ) )
+         {
+            nodes[ refs[j] - numCon ].neededBy.push_back( i );
+            nodes[ i ].needs.push_back( refs[j] - numCon );
+         }
+      }
+   }
+}
+
+bool writeReorderedDER( InputFile &pf, OutputFile &optF, streampos fposDer, int &numCon, vector<Node> &nodes, vector<int> &L )
 {
    string section, tmp, label;
    char sense;